@@ -0,0 +1,183 @@
+#pragma once
+
+#include "linesFrame.h"
+#include "predicates.h"
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Inputs shorter than this are sorted on the calling thread only.
+constexpr size_t PARALLEL_SORT_MIN = 1 << 14;
+
+// std::sort on `threads` threads: chunks are sorted concurrently and then
+// merged pairwise, with the merges of one round also run concurrently.
+template <typename It, typename Less>
+void parallelSort(It first, It last, Less less, size_t threads) {
+  size_t n = last - first;
+  if (threads <= 1 || n < PARALLEL_SORT_MIN) {
+    std::sort(first, last, less);
+    return;
+  }
+  std::vector<size_t> bounds;
+  for (size_t t = 0; t <= threads; ++t) {
+    bounds.push_back(n * t / threads);
+  }
+  auto run = [](std::vector<std::thread> &workers) {
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    workers.clear();
+  };
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::sort(first + bounds[t], first + bounds[t + 1], less);
+    });
+  }
+  run(workers);
+  for (size_t width = 1; width < threads; width *= 2) {
+    for (size_t t = 0; t + width < threads; t += 2 * width) {
+      size_t mid = bounds[t + width];
+      size_t end = bounds[std::min(threads, t + 2 * width)];
+      workers.emplace_back([&, t, mid, end] {
+        std::inplace_merge(first + bounds[t], first + mid, first + end, less);
+      });
+    }
+    run(workers);
+  }
+}
+
+// Vertices of the convex hull of `points`, counterclockwise from the
+// lowest leftmost one, written to `hull`, which must have room for all
+// points. Returns their number. Andrew's monotone chain with exact turn
+// tests, so collinear points are left out.
+inline size_t convexHull(std::span<const Point> points, std::span<Point> hull,
+                         size_t threads = 1) {
+  if (hull.size() < points.size()) {
+    throw std::invalid_argument("Error: hull buffer is too small");
+  }
+  std::vector<Point> sorted(points.begin(), points.end());
+  parallelSort(sorted.begin(), sorted.end(), std::less<Point>(), threads);
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+  size_t n = sorted.size();
+  if (n < 3) {
+    std::copy(sorted.begin(), sorted.end(), hull.begin());
+    return n;
+  }
+  // The chains need one slot more than there are points when every point
+  // is on the hull, so they are built aside and copied once trimmed.
+  std::vector<Point> chain(n + 1);
+  auto turnsLeft = [&](size_t k, const Point &p) {
+    return robust::orientation(chain[k - 2], chain[k - 1], p) > 0;
+  };
+  size_t k = 0;
+  for (size_t i = 0; i < n; ++i) {
+    while (k >= 2 && !turnsLeft(k, sorted[i])) {
+      --k;
+    }
+    chain[k++] = sorted[i];
+  }
+  // The upper chain runs back to sorted[0], which is already chain[0].
+  size_t lower = k + 1;
+  for (size_t i = n - 1; i-- > 1;) {
+    while (k >= lower && !turnsLeft(k, sorted[i])) {
+      --k;
+    }
+    chain[k++] = sorted[i];
+  }
+  while (k >= lower && !turnsLeft(k, sorted[0])) {
+    --k;
+  }
+  std::copy(chain.begin(), chain.begin() + k, hull.begin());
+  return k;
+}
+
+// Vertices of the intersection of the half-planes a x + b y + c >= 0, one
+// per line, counterclockwise, written to `vertices`, which must have room
+// for one vertex per half-plane. Returns their number, which is 0 if the
+// region is empty, has no area or is unbounded; add a bounding box for
+// regions that may be unbounded. Half-planes are sorted by the angle of
+// their boundary and then swept once with a deque, in O(n log n).
+inline size_t halfPlaneIntersection(std::span<const Line> planes,
+                                    std::span<Point> vertices,
+                                    size_t threads = 1) {
+  if (vertices.size() < planes.size()) {
+    throw std::invalid_argument("Error: vertex buffer is too small");
+  }
+  // The boundary runs along (b, -a) with the half-plane on its left.
+  std::vector<double> angle(planes.size());
+  std::vector<size_t> order(planes.size());
+  for (size_t i = 0; i < planes.size(); ++i) {
+    angle[i] = std::atan2(-planes[i].a(), planes[i].b());
+    order[i] = i;
+  }
+  parallelSort(
+      order.begin(), order.end(),
+      [&](size_t i, size_t j) { return angle[i] < angle[j]; }, threads);
+
+  auto outside = [](const Line &plane, const Point &p) {
+    return plane.a() * p.first + plane.b() * p.second + plane.c() < -EPS;
+  };
+  auto meet = [](const Line &l1, const Line &l2) {
+    double det = l1.a() * l2.b() - l2.a() * l1.b();
+    return Point{(l1.b() * l2.c() - l2.b() * l1.c()) / det,
+                 (l1.c() * l2.a() - l2.c() * l1.a()) / det};
+  };
+  // The deque is deque[head, tail); every plane is pushed at most once, so
+  // tail never passes the end.
+  std::vector<size_t> deque(planes.size());
+  size_t head = 0, tail = 0;
+  for (size_t i : order) {
+    const Line &plane = planes[i];
+    while (tail - head > 1 &&
+           outside(plane,
+                   meet(planes[deque[tail - 1]], planes[deque[tail - 2]]))) {
+      --tail;
+    }
+    while (tail - head > 1 &&
+           outside(plane, meet(planes[deque[head]], planes[deque[head + 1]]))) {
+      ++head;
+    }
+    if (tail > head && robust::isParallel(plane, planes[deque[tail - 1]])) {
+      const Line &last = planes[deque[tail - 1]];
+      if (plane.a() * last.a() + plane.b() * last.b() < 0) {
+        // Opposite half-planes met with nothing in between.
+        return 0;
+      }
+      // Same direction: keep the one that is further inside.
+      double norm = last.a() * last.a() + last.b() * last.b();
+      Point onLast{-last.a() * last.c() / norm, -last.b() * last.c() / norm};
+      if (!outside(plane, onLast)) {
+        continue;
+      }
+      --tail;
+    }
+    deque[tail++] = i;
+  }
+  while (tail - head > 2 &&
+         outside(planes[deque[head]],
+                 meet(planes[deque[tail - 1]], planes[deque[tail - 2]]))) {
+    --tail;
+  }
+  while (tail - head > 2 &&
+         outside(planes[deque[tail - 1]],
+                 meet(planes[deque[head]], planes[deque[head + 1]]))) {
+    ++head;
+  }
+  size_t count = tail - head;
+  if (count < 3) {
+    return 0;
+  }
+  for (size_t k = 0; k < count; ++k) {
+    const Line &l1 = planes[deque[head + k]];
+    const Line &l2 = planes[deque[head + (k + 1) % count]];
+    if (l1.a() * l2.b() - l2.a() * l1.b() <= 0) {
+      // The boundary turns by half a circle or more: it is unbounded.
+      return 0;
+    }
+    vertices[k] = meet(l1, l2);
+  }
+  return count;
+}
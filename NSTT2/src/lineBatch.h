@@ -0,0 +1,192 @@
+#pragma once
+
+#include "linesFrame.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Doubles processed together: four with AVX, two otherwise. GCC and Clang
+// lower the vector operations to whatever the target has.
+#if defined(__AVX__)
+constexpr size_t LANE_BYTES = 32;
+#else
+constexpr size_t LANE_BYTES = 16;
+#endif
+typedef double Lanes __attribute__((vector_size(LANE_BYTES)));
+typedef long long LaneMask __attribute__((vector_size(LANE_BYTES)));
+
+constexpr size_t LANES = sizeof(Lanes) / sizeof(double);
+
+inline Lanes loadLanes(const double *p) {
+  Lanes v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline void storeLanes(double *p, Lanes v) { std::memcpy(p, &v, sizeof(v)); }
+
+inline Lanes splat(double value) { return Lanes{} + value; }
+
+// Lanes where |v| < EPS.
+inline LaneMask nearZero(Lanes v) {
+  Lanes eps = splat(EPS);
+  return (v < eps) & (v > -eps);
+}
+
+inline void storeMask(unsigned char *p, LaneMask mask) {
+  for (size_t k = 0; k < LANES; ++k) {
+    p[k] = mask[k] != 0;
+  }
+}
+
+// Points stored as two coordinate columns.
+struct PointBatch {
+  std::vector<double> x, y;
+
+  void push_back(const Point &p) {
+    x.push_back(p.first);
+    y.push_back(p.second);
+  }
+
+  void resize(size_t size) {
+    x.resize(size);
+    y.resize(size);
+  }
+
+  size_t size() const { return x.size(); }
+
+  Point operator[](size_t i) const { return Point{x[i], y[i]}; }
+};
+
+// Lines stored as three coefficient columns, so that the same test can run
+// on several lines at once. The kernels give the same answers as the
+// corresponding Line methods but never branch per line; intersections use
+// Cramer's rule, which needs no special case for a_ == 0.
+class LineBatch {
+  std::vector<double> a_, b_, c_;
+
+  void checkSize(size_t size) const {
+    if (size != a_.size()) {
+      throw std::invalid_argument("Batch sizes differ");
+    }
+  }
+
+public:
+  LineBatch() = default;
+
+  explicit LineBatch(std::span<const Line> lines) {
+    reserve(lines.size());
+    for (const Line &line : lines) {
+      push_back(line);
+    }
+  }
+
+  void reserve(size_t size) {
+    a_.reserve(size);
+    b_.reserve(size);
+    c_.reserve(size);
+  }
+
+  void push_back(const Line &line) {
+    a_.push_back(line.a());
+    b_.push_back(line.b());
+    c_.push_back(line.c());
+  }
+
+  size_t size() const { return a_.size(); }
+
+  Line operator[](size_t i) const { return Line{a_[i], b_[i], c_[i]}; }
+
+  const double *a() const { return a_.data(); }
+  const double *b() const { return b_.data(); }
+  const double *c() const { return c_.data(); }
+
+  // result[i] is 1 when line i is parallel to line i of `other`.
+  void isParallel(const LineBatch &other,
+                  std::span<unsigned char> result) const {
+    checkSize(other.size());
+    checkSize(result.size());
+    size_t n = size(), i = 0;
+    for (; i + LANES <= n; i += LANES) {
+      Lanes det = loadLanes(&a_[i]) * loadLanes(&other.b_[i]) -
+                  loadLanes(&other.a_[i]) * loadLanes(&b_[i]);
+      storeMask(&result[i], nearZero(det));
+    }
+    for (; i < n; ++i) {
+      result[i] = std::abs(a_[i] * other.b_[i] - other.a_[i] * b_[i]) < EPS;
+    }
+  }
+
+  // Intersection of line i with line i of `other`, written to points[i].
+  // Parallel pairs get NaN coordinates instead of throwing. Returns the
+  // number of pairs that do intersect.
+  size_t intersection(const LineBatch &other, PointBatch &points) const {
+    checkSize(other.size());
+    points.resize(size());
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t n = size(), i = 0, count = 0;
+    for (; i + LANES <= n; i += LANES) {
+      Lanes a1 = loadLanes(&a_[i]), b1 = loadLanes(&b_[i]),
+            c1 = loadLanes(&c_[i]);
+      Lanes a2 = loadLanes(&other.a_[i]), b2 = loadLanes(&other.b_[i]),
+            c2 = loadLanes(&other.c_[i]);
+      Lanes det = a1 * b2 - a2 * b1;
+      LaneMask parallel = nearZero(det);
+      // Divide by 1 in parallel lanes so that no lane traps or warns.
+      Lanes safe = parallel ? splat(1) : det;
+      Lanes x = (b1 * c2 - b2 * c1) / safe;
+      Lanes y = (c1 * a2 - c2 * a1) / safe;
+      storeLanes(&points.x[i], parallel ? splat(nan) : x);
+      storeLanes(&points.y[i], parallel ? splat(nan) : y);
+      for (size_t k = 0; k < LANES; ++k) {
+        count += parallel[k] == 0;
+      }
+    }
+    for (; i < n; ++i) {
+      double det = a_[i] * other.b_[i] - other.a_[i] * b_[i];
+      bool parallel = std::abs(det) < EPS;
+      double safe = parallel ? 1 : det;
+      double x = (b_[i] * other.c_[i] - other.b_[i] * c_[i]) / safe;
+      double y = (c_[i] * other.a_[i] - other.c_[i] * a_[i]) / safe;
+      points.x[i] = parallel ? nan : x;
+      points.y[i] = parallel ? nan : y;
+      count += !parallel;
+    }
+    return count;
+  }
+
+  // result[i] is 1 when line i passes through `p`.
+  void belong(const Point &p, std::span<unsigned char> result) const {
+    checkSize(result.size());
+    size_t n = size(), i = 0;
+    Lanes x = splat(p.first), y = splat(p.second);
+    for (; i + LANES <= n; i += LANES) {
+      Lanes value =
+          loadLanes(&a_[i]) * x + loadLanes(&b_[i]) * y + loadLanes(&c_[i]);
+      storeMask(&result[i], nearZero(value));
+    }
+    for (; i < n; ++i) {
+      result[i] = std::abs(a_[i] * p.first + b_[i] * p.second + c_[i]) < EPS;
+    }
+  }
+
+  // result[i] is 1 when `line` passes through points[i].
+  static void belong(const Line &line, const PointBatch &points,
+                     std::span<unsigned char> result) {
+    if (result.size() != points.size()) {
+      throw std::invalid_argument("Batch sizes differ");
+    }
+    size_t n = points.size(), i = 0;
+    Lanes a = splat(line.a()), b = splat(line.b()), c = splat(line.c());
+    for (; i + LANES <= n; i += LANES) {
+      Lanes value =
+          a * loadLanes(&points.x[i]) + b * loadLanes(&points.y[i]) + c;
+      storeMask(&result[i], nearZero(value));
+    }
+    for (; i < n; ++i) {
+      result[i] = line.belong(points[i]);
+    }
+  }
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "linesFrame.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Euclidean distance from `p` to `line`.
+inline double distance(const Line &line, const Point &p) {
+  return std::abs(line.a() * p.first + line.b() * p.second + line.c()) /
+         std::hypot(line.a(), line.b());
+}
+
+// Uniform grid over a bounded window that lists, for every cell, the lines
+// crossing it. A line is added to the cells it passes within belong()'s
+// tolerance of, so incidence needs only the cell of the point, and the
+// nearest line is found by searching rings of cells outward from it.
+// Lines that miss the window, and points outside it, fall back to a scan.
+class LineGrid {
+  double minX_, minY_, maxX_, maxY_;
+  size_t side_;
+  double cellWidth_, cellHeight_;
+  std::vector<Line> lines_;
+  std::vector<std::vector<uint32_t>> cells_;
+  // Lines that do not cross the window.
+  std::vector<uint32_t> outside_;
+
+  bool inside(const Point &p) const {
+    return p.first >= minX_ && p.first <= maxX_ && p.second >= minY_ &&
+           p.second <= maxY_;
+  }
+
+  size_t column(double x) const {
+    double i = std::floor((x - minX_) / cellWidth_);
+    return static_cast<size_t>(std::clamp(i, 0.0, double(side_ - 1)));
+  }
+
+  size_t row(double y) const {
+    double i = std::floor((y - minY_) / cellHeight_);
+    return static_cast<size_t>(std::clamp(i, 0.0, double(side_ - 1)));
+  }
+
+  // Adds line `id` to every cell it crosses, walking columns for flat
+  // lines and rows for steep ones so that each step covers few cells.
+  // False if it misses the window.
+  bool rasterize(uint32_t id) {
+    const Line &line = lines_[id];
+    bool flat = std::abs(line.b()) >= std::abs(line.a());
+    // Along the walking axis u the line is v(u) = -(p u + c) / q, and
+    // belong() accepts points within EPS / |q| of it.
+    double p = flat ? line.a() : line.b(), q = flat ? line.b() : line.a();
+    double uMin = flat ? minX_ : minY_, vMin = flat ? minY_ : minX_;
+    double vMax = flat ? maxY_ : maxX_;
+    double uStep = flat ? cellWidth_ : cellHeight_;
+    double vStep = flat ? cellHeight_ : cellWidth_;
+    double pad = EPS / std::abs(q);
+    bool added = false;
+    for (size_t i = 0; i < side_; ++i) {
+      double u0 = uMin + i * uStep, u1 = u0 + uStep;
+      double v0 = -(p * u0 + line.c()) / q, v1 = -(p * u1 + line.c()) / q;
+      double lo = std::min(v0, v1) - pad, hi = std::max(v0, v1) + pad;
+      if (hi < vMin || lo > vMax) {
+        continue;
+      }
+      size_t first = static_cast<size_t>(
+          std::clamp(std::floor((lo - vMin) / vStep), 0.0, double(side_ - 1)));
+      size_t last = static_cast<size_t>(
+          std::clamp(std::floor((hi - vMin) / vStep), 0.0, double(side_ - 1)));
+      for (size_t j = first; j <= last; ++j) {
+        size_t cell = flat ? j * side_ + i : i * side_ + j;
+        cells_[cell].push_back(id);
+      }
+      added = true;
+    }
+    return added;
+  }
+
+  // Calls `body(i)` for i in [0, n), split over `threads` threads.
+  template <typename Body>
+  static void forEach(size_t n, size_t threads, const Body &body) {
+    threads = std::max<size_t>(1, std::min(threads, n));
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        for (size_t i = n * t / threads; i < n * (t + 1) / threads; ++i) {
+          body(i);
+        }
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+public:
+  // A window [min, max] split into side x side cells.
+  LineGrid(const Point &min, const Point &max, size_t side)
+      : minX_(min.first), minY_(min.second), maxX_(max.first),
+        maxY_(max.second), side_(side),
+        cellWidth_((max.first - min.first) / side),
+        cellHeight_((max.second - min.second) / side),
+        cells_(side * side) {
+    if (side == 0 || !(cellWidth_ > 0) || !(cellHeight_ > 0)) {
+      throw std::invalid_argument("Error: empty grid window");
+    }
+  }
+
+  // Adds a line and returns its index. Nothing already indexed is
+  // touched, so the grid can grow while it is being used.
+  size_t add(const Line &line) {
+    uint32_t id = static_cast<uint32_t>(lines_.size());
+    lines_.push_back(line);
+    if (!rasterize(id)) {
+      outside_.push_back(id);
+    }
+    return id;
+  }
+
+  size_t size() const { return lines_.size(); }
+
+  const Line &operator[](size_t i) const { return lines_[i]; }
+
+  // Indices of the lines that pass through `p`, in insertion order.
+  std::vector<size_t> incident(const Point &p) const {
+    std::vector<size_t> result;
+    if (!inside(p)) {
+      for (size_t i = 0; i < lines_.size(); ++i) {
+        if (lines_[i].belong(p)) {
+          result.push_back(i);
+        }
+      }
+      return result;
+    }
+    for (uint32_t id : cells_[row(p.second) * side_ + column(p.first)]) {
+      if (lines_[id].belong(p)) {
+        result.push_back(id);
+      }
+    }
+    for (uint32_t id : outside_) {
+      if (lines_[id].belong(p)) {
+        result.push_back(id);
+      }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  // Index of the line closest to `p`; empty if there are no lines.
+  std::optional<size_t> nearest(const Point &p) const {
+    std::optional<size_t> best;
+    double bestDistance = std::numeric_limits<double>::infinity();
+    auto consider = [&](size_t id) {
+      double d = distance(lines_[id], p);
+      if (!best || d < bestDistance || (d == bestDistance && id < *best)) {
+        best = id;
+        bestDistance = d;
+      }
+    };
+    if (!inside(p)) {
+      for (size_t i = 0; i < lines_.size(); ++i) {
+        consider(i);
+      }
+      return best;
+    }
+    for (uint32_t id : outside_) {
+      consider(id);
+    }
+    // A line closer than the window border touches the window within
+    // that distance of p, so the rings below find it.
+    double border = std::min({p.first - minX_, maxX_ - p.first,
+                              p.second - minY_, maxY_ - p.second});
+    double cell = std::min(cellWidth_, cellHeight_);
+    size_t i0 = column(p.first), j0 = row(p.second);
+    for (size_t ring = 0; ring < side_; ++ring) {
+      size_t iLo = i0 >= ring ? i0 - ring : 0;
+      size_t iHi = std::min(side_ - 1, i0 + ring);
+      size_t jLo = j0 >= ring ? j0 - ring : 0;
+      size_t jHi = std::min(side_ - 1, j0 + ring);
+      for (size_t j = jLo; j <= jHi; ++j) {
+        bool edge = j + ring == j0 || j == j0 + ring;
+        for (size_t i = iLo; i <= iHi; ++i) {
+          if (!edge && i + ring != i0 && i != i0 + ring) {
+            continue;
+          }
+          for (uint32_t id : cells_[j * side_ + i]) {
+            consider(id);
+          }
+        }
+      }
+      // Cells beyond this ring are at least ring * cell away from p.
+      if (bestDistance <= std::min(border, ring * cell)) {
+        break;
+      }
+    }
+    return best;
+  }
+
+  std::vector<std::vector<size_t>> incident(const std::vector<Point> &points,
+                                            size_t threads = 1) const {
+    std::vector<std::vector<size_t>> result(points.size());
+    forEach(points.size(), threads,
+            [&](size_t i) { result[i] = incident(points[i]); });
+    return result;
+  }
+
+  std::vector<std::optional<size_t>> nearest(const std::vector<Point> &points,
+                                             size_t threads = 1) const {
+    std::vector<std::optional<size_t>> result(points.size());
+    forEach(points.size(), threads,
+            [&](size_t i) { result[i] = nearest(points[i]); });
+    return result;
+  }
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "linesFrame.h"
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Coefficients scaled so that the normal (a, b) has unit length and points
+// into the upper half-plane (or along +x when b == 0). Every multiple of a
+// line has the same canonical form.
+struct CanonicalLine {
+  // Angle of the normal, in [0, pi).
+  double angle;
+  // Signed distance c / |(a, b)| of the line from the origin.
+  double offset;
+
+  explicit CanonicalLine(const Line &line) {
+    double norm = std::hypot(line.a(), line.b());
+    double sign = line.b() < 0 || (line.b() == 0 && line.a() < 0) ? -1 : 1;
+    angle = std::atan2(sign * line.b(), sign * line.a());
+    offset = sign * line.c() / norm;
+  }
+};
+
+struct LineGroups {
+  // Per line, the dense index of its class of parallel lines and of its
+  // class of identical lines.
+  std::vector<size_t> parallelClass, identicalClass;
+  size_t parallelClasses = 0, identicalClasses = 0;
+  // Pairs of lines that meet in exactly one point.
+  uint64_t intersectingPairs = 0;
+};
+
+// Union-find with path halving over dense indices.
+class DisjointSets {
+  std::vector<uint32_t> parent_;
+
+public:
+  explicit DisjointSets(size_t size) : parent_(size) {
+    std::iota(parent_.begin(), parent_.end(), 0);
+  }
+
+  uint32_t find(uint32_t i) {
+    while (parent_[i] != i) {
+      i = parent_[i] = parent_[parent_[i]];
+    }
+    return i;
+  }
+
+  void unite(uint32_t i, uint32_t j) {
+    i = find(i);
+    j = find(j);
+    if (i != j) {
+      parent_[std::max(i, j)] = std::min(i, j);
+    }
+  }
+
+  // Dense class index per element, numbered by first appearance.
+  size_t classes(std::vector<size_t> &result) {
+    result.assign(parent_.size(), 0);
+    std::vector<size_t> index(parent_.size(), SIZE_MAX);
+    size_t count = 0;
+    for (uint32_t i = 0; i < parent_.size(); ++i) {
+      size_t &root = index[find(i)];
+      if (root == SIZE_MAX) {
+        root = count++;
+      }
+      result[i] = root;
+    }
+    return count;
+  }
+};
+
+// Groups values by hashing them into buckets of width `tolerance` under a
+// group key, in expected O(n). Everything in a bucket is joined. Values
+// close to each other across a bucket boundary are joined as well, but a
+// bucket is only joined to the one below it when that one is not already
+// joined lower down, so a class never spans more than two buckets and its
+// values differ by less than 2 * tolerance.
+class ToleranceBuckets {
+  struct Bucket {
+    uint32_t min, max;
+    // Whether the bucket is joined to the one below it.
+    bool joined = false;
+  };
+  struct KeyHash {
+    size_t operator()(const std::pair<uint64_t, int64_t> &key) const {
+      return std::hash<uint64_t>()(key.first * 0x9E3779B97F4A7C15ull ^
+                                   static_cast<uint64_t>(key.second));
+    }
+  };
+
+  const std::vector<double> &values_;
+  double tolerance_;
+  std::unordered_map<std::pair<uint64_t, int64_t>, Bucket, KeyHash> buckets_;
+
+public:
+  ToleranceBuckets(const std::vector<double> &values, double tolerance)
+      : values_(values), tolerance_(tolerance) {
+    if (!(tolerance > 0)) {
+      throw std::invalid_argument("Error: tolerance must be positive");
+    }
+    buckets_.reserve(values.size());
+  }
+
+  void add(uint64_t group, uint32_t i, DisjointSets &sets) {
+    int64_t bucket = static_cast<int64_t>(std::floor(values_[i] / tolerance_));
+    auto [it, added] = buckets_.try_emplace({group, bucket}, Bucket{i, i});
+    if (added) {
+      return;
+    }
+    sets.unite(it->second.min, i);
+    if (values_[i] < values_[it->second.min]) {
+      it->second.min = i;
+    }
+    if (values_[i] > values_[it->second.max]) {
+      it->second.max = i;
+    }
+  }
+
+  // Walks each run of consecutive buckets upwards from its lowest one, so
+  // every bucket is visited once.
+  void joinNeighbours(DisjointSets &sets) {
+    for (const auto &[key, bucket] : buckets_) {
+      if (buckets_.contains({key.first, key.second - 1})) {
+        continue;
+      }
+      const Bucket *below = &bucket;
+      for (auto next = buckets_.find({key.first, key.second + 1});
+           next != buckets_.end();
+           next = buckets_.find({key.first, next->first.second + 1})) {
+        Bucket &above = next->second;
+        if (!below->joined &&
+            values_[above.min] - values_[below->max] <= tolerance_) {
+          sets.unite(below->max, above.min);
+          above.joined = true;
+        }
+        below = &above;
+      }
+    }
+  }
+};
+
+// Parallel classes, identical lines and the number of intersecting pairs,
+// in expected O(n) instead of calling isParallel on every pair. Normal
+// angles are bucketed by `angleTolerance` radians into parallel classes,
+// and the offsets within each class by `offsetTolerance` into identical
+// ones, as ToleranceBuckets does: lines closer than the tolerance are
+// grouped unless they fall on either side of an already joined boundary,
+// and no class spans more than two tolerances.
+inline LineGroups groupLines(std::span<const Line> lines,
+                             double angleTolerance = EPS,
+                             double offsetTolerance = EPS) {
+  size_t n = lines.size();
+  const double pi = std::acos(-1.0);
+  std::vector<double> angle(n), offset(n);
+  for (size_t i = 0; i < n; ++i) {
+    CanonicalLine canonical(lines[i]);
+    angle[i] = canonical.angle;
+    offset[i] = canonical.offset;
+    // Normals just below pi are close to those just above 0: turned
+    // around, they land in the buckets below 0 with negated offsets.
+    if (angle[i] > pi - angleTolerance) {
+      angle[i] -= pi;
+      offset[i] = -offset[i];
+    }
+  }
+
+  LineGroups groups;
+  DisjointSets parallel(n);
+  ToleranceBuckets angles(angle, angleTolerance);
+  for (uint32_t i = 0; i < n; ++i) {
+    angles.add(0, i, parallel);
+  }
+  angles.joinNeighbours(parallel);
+  groups.parallelClasses = parallel.classes(groups.parallelClass);
+
+  std::vector<uint64_t> classSize(groups.parallelClasses);
+  DisjointSets identical(n);
+  ToleranceBuckets offsets(offset, offsetTolerance);
+  for (uint32_t i = 0; i < n; ++i) {
+    ++classSize[groups.parallelClass[i]];
+    offsets.add(groups.parallelClass[i], i, identical);
+  }
+  offsets.joinNeighbours(identical);
+  groups.identicalClasses = identical.classes(groups.identicalClass);
+
+  groups.intersectingPairs = n < 2 ? 0 : static_cast<uint64_t>(n) * (n - 1) / 2;
+  for (uint64_t size : classSize) {
+    groups.intersectingPairs -= size * (size - 1) / 2;
+  }
+  return groups;
+}
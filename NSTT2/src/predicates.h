@@ -0,0 +1,147 @@
+#pragma once
+
+#include "linesFrame.h"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// Exact geometric predicates for double inputs. Each one evaluates its
+// expression in plain double precision first and trusts the sign when it
+// is larger than a static bound on the rounding error; only the rare
+// inputs too close to zero are recomputed exactly with floating-point
+// expansions (Shewchuk's arithmetic). Results are exact unless the
+// intermediate products overflow or underflow.
+namespace robust {
+
+namespace detail {
+
+// Unit roundoff, 2^-53.
+constexpr double U = std::numeric_limits<double>::epsilon() / 2;
+
+// Error bounds relative to the sum of the magnitudes of the terms.
+constexpr double ORIENTATION_BOUND = (3 + 16 * U) * U;
+constexpr double PRODUCTS_BOUND = (3 + 16 * U) * U;
+constexpr double INCIDENCE_BOUND = (4 + 16 * U) * U;
+
+// a + b == sum + err exactly.
+inline void twoSum(double a, double b, double &sum, double &err) {
+  sum = a + b;
+  double bv = sum - a, av = sum - bv;
+  err = (a - av) + (b - bv);
+}
+
+// a * b == product + err exactly.
+inline void twoProduct(double a, double b, double &product, double &err) {
+  product = a * b;
+  err = std::fma(a, b, -product);
+}
+
+// Sum of up to N doubles kept as a nonoverlapping expansion, smallest
+// component first, without zeros.
+template <size_t N> class Expansion {
+  double terms_[N];
+  size_t size_ = 0;
+
+public:
+  void add(double value) {
+    size_t k = 0;
+    for (size_t i = 0; i < size_; ++i) {
+      double sum, err;
+      twoSum(value, terms_[i], sum, err);
+      if (err != 0) {
+        terms_[k++] = err;
+      }
+      value = sum;
+    }
+    if (value != 0) {
+      terms_[k++] = value;
+    }
+    size_ = k;
+  }
+
+  void addProduct(double a, double b) {
+    double product, err;
+    twoProduct(a, b, product, err);
+    add(err);
+    add(product);
+  }
+
+  // The largest component decides the sign.
+  int sign() const {
+    return size_ == 0 ? 0 : terms_[size_ - 1] > 0 ? 1 : -1;
+  }
+};
+
+inline int sign(double value) { return (value > 0) - (value < 0); }
+
+// Sign of a * b - c * d.
+inline int productsSign(double a, double b, double c, double d) {
+  double left = a * b, right = c * d;
+  double det = left - right;
+  if (std::abs(det) > PRODUCTS_BOUND * (std::abs(left) + std::abs(right))) {
+    return sign(det);
+  }
+  Expansion<4> exact;
+  exact.addProduct(a, b);
+  exact.addProduct(-c, d);
+  return exact.sign();
+}
+
+} // namespace detail
+
+// 1 if r lies to the left of the directed line p -> q, -1 if it lies to
+// the right and 0 if the three points are collinear.
+inline int orientation(const Point &p, const Point &q, const Point &r) {
+  double left = (q.first - p.first) * (r.second - p.second);
+  double right = (q.second - p.second) * (r.first - p.first);
+  double det = left - right;
+  if (std::abs(det) >
+      detail::ORIENTATION_BOUND * (std::abs(left) + std::abs(right))) {
+    return detail::sign(det);
+  }
+  // Each difference is hi + lo exactly, so each product has four parts.
+  double dx1, dx1e, dy2, dy2e, dy1, dy1e, dx2, dx2e;
+  detail::twoSum(q.first, -p.first, dx1, dx1e);
+  detail::twoSum(r.second, -p.second, dy2, dy2e);
+  detail::twoSum(q.second, -p.second, dy1, dy1e);
+  detail::twoSum(r.first, -p.first, dx2, dx2e);
+  detail::Expansion<16> exact;
+  for (double x : {dx1, dx1e}) {
+    for (double y : {dy2, dy2e}) {
+      exact.addProduct(x, y);
+    }
+  }
+  for (double y : {dy1, dy1e}) {
+    for (double x : {dx2, dx2e}) {
+      exact.addProduct(-y, x);
+    }
+  }
+  return exact.sign();
+}
+
+// Exact counterpart of Line::isParallel: a1 * b2 == a2 * b1.
+inline bool isParallel(const Line &l1, const Line &l2) {
+  return detail::productsSign(l1.a(), l2.b(), l2.a(), l1.b()) == 0;
+}
+
+// Sign of a * x + b * y + c: which side of `line` the point is on.
+inline int side(const Line &line, const Point &p) {
+  double ax = line.a() * p.first, by = line.b() * p.second;
+  double value = ax + by + line.c();
+  double magnitude = std::abs(ax) + std::abs(by) + std::abs(line.c());
+  if (std::abs(value) > detail::INCIDENCE_BOUND * magnitude) {
+    return detail::sign(value);
+  }
+  detail::Expansion<5> exact;
+  exact.addProduct(line.a(), p.first);
+  exact.addProduct(line.b(), p.second);
+  exact.add(line.c());
+  return exact.sign();
+}
+
+// Exact counterpart of Line::belong.
+inline bool belong(const Line &line, const Point &p) {
+  return side(line, p) == 0;
+}
+
+} // namespace robust
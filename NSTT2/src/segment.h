@@ -0,0 +1,349 @@
+#pragma once
+
+#include "linesFrame.h"
+#include "predicates.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Part of a line between two distinct points. The endpoints are stored in
+// sweep order: start() is left of end(), or below it for vertical segments.
+class Segment {
+  Point start_, end_;
+
+public:
+  Segment(const Point &p1, const Point &p2)
+      : start_(std::min(p1, p2)), end_(std::max(p1, p2)) {
+    if (p1 == p2) {
+      throw std::invalid_argument("Error: segment endpoints are equal");
+    }
+  }
+
+  const Point &start() const { return start_; }
+
+  const Point &end() const { return end_; }
+
+  bool isVertical() const { return start_.first == end_.first; }
+
+  double slope() const {
+    if (isVertical()) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return (end_.second - start_.second) / (end_.first - start_.first);
+  }
+
+  Line line() const {
+    double a = end_.second - start_.second;
+    double b = start_.first - end_.first;
+    return Line{a, b, -(a * start_.first + b * start_.second)};
+  }
+
+  // y of the segment at `x`, clamped to the endpoints. Not for vertical
+  // segments.
+  double yAt(double x) const {
+    if (x <= start_.first) {
+      return start_.second;
+    }
+    if (x >= end_.first) {
+      return end_.second;
+    }
+    return start_.second + (x - start_.first) * slope();
+  }
+
+  // The single common point, if there is one. Collinear segments have
+  // none, even when they overlap.
+  std::optional<Point> intersection(const Segment &other) const {
+    // Slack in the segment parameters for endpoints that touch.
+    const double slack = 1e-9;
+    double rx = end_.first - start_.first, ry = end_.second - start_.second;
+    double sx = other.end_.first - other.start_.first;
+    double sy = other.end_.second - other.start_.second;
+    double det = rx * sy - ry * sx;
+    if (det == 0) {
+      return std::nullopt;
+    }
+    double qx = other.start_.first - start_.first;
+    double qy = other.start_.second - start_.second;
+    double t = (qx * sy - qy * sx) / det;
+    double u = (qx * ry - qy * rx) / det;
+    if (t < -slack || t > 1 + slack || u < -slack || u > 1 + slack) {
+      return std::nullopt;
+    }
+    // Prefer exact endpoints to recomputed ones.
+    if (t <= 0 || t >= 1) {
+      return t <= 0 ? start_ : end_;
+    }
+    if (u <= 0 || u >= 1) {
+      return u <= 0 ? other.start_ : other.end_;
+    }
+    return Point{start_.first + t * rx, start_.second + t * ry};
+  }
+};
+
+// Distance within which the sweep treats a segment as passing through an
+// event point: a few thousand ulps of the largest coordinate, which covers
+// the rounding of computed intersection points at any scale.
+inline double snapTolerance(const std::vector<Segment> &segments) {
+  double scale = std::numeric_limits<double>::min();
+  for (const Segment &segment : segments) {
+    scale = std::max({scale, std::abs(segment.start().first),
+                      std::abs(segment.start().second),
+                      std::abs(segment.end().first),
+                      std::abs(segment.end().second)});
+  }
+  return 1e-12 * scale;
+}
+
+struct SegmentIntersection {
+  // Indices into the input, first < second.
+  size_t first, second;
+  Point point;
+};
+
+// Bentley-Ottmann sweep from left to right over the events in a map keyed
+// by point. The status is a set of the segments crossing the sweep line,
+// ordered by their height there; every segment keeps its set iterator so
+// it can be removed without comparing. Segments passing through an event
+// point are only candidates, since heights are snapped to it; each pair is
+// confirmed on the original segments before it is reported. Only
+// intersections at points with lo <= x < hi are reported, which lets
+// slabs share the work: a slab sweeps clipped segments, and ids maps them
+// back to the originals, from which intersection points are computed so
+// that all slabs agree on them.
+class SegmentSweep {
+  struct Below {
+    using is_transparent = void;
+    const SegmentSweep *sweep;
+
+    bool operator()(size_t a, size_t b) const {
+      double ya = sweep->height(a), yb = sweep->height(b);
+      if (ya != yb) {
+        return ya < yb;
+      }
+      // Both pass through the event point: order them just right of it.
+      double sa = sweep->segments_[a].slope();
+      double sb = sweep->segments_[b].slope();
+      return sa != sb ? sa < sb : a < b;
+    }
+    bool operator()(size_t a, double y) const { return sweep->height(a) < y; }
+    bool operator()(double y, size_t a) const { return y < sweep->height(a); }
+  };
+
+  const std::vector<Segment> &segments_;
+  const std::vector<Segment> &originals_;
+  const std::vector<size_t> &ids_;
+  double lo_, hi_;
+  double tolerance_;
+  Point event_;
+  std::set<size_t, Below> status_;
+  std::vector<std::set<size_t, Below>::iterator> where_;
+  // Segments that start at each event point.
+  std::map<Point, std::vector<size_t>> events_;
+  std::unordered_set<uint64_t> reported_;
+  std::vector<SegmentIntersection> &out_;
+
+  // Height of a segment at the sweep line, snapped to the event point
+  // when it passes within the tolerance of it.
+  double height(size_t s) const {
+    const Segment &segment = segments_[s];
+    double y = segment.isVertical()
+                   ? std::clamp(event_.second, segment.start().second,
+                                segment.end().second)
+                   : segment.yAt(event_.first);
+    return std::abs(y - event_.second) <= tolerance_ ? event_.second : y;
+  }
+
+  // Where two original segments meet. Collinear ones that overlap meet at
+  // the later of their starts, which lies on both.
+  std::optional<Point> meet(size_t first, size_t second) const {
+    const Segment &s = originals_[first], &t = originals_[second];
+    if (std::optional<Point> p = s.intersection(t)) {
+      return p;
+    }
+    if (robust::orientation(s.start(), s.end(), t.start()) != 0 ||
+        robust::orientation(s.start(), s.end(), t.end()) != 0) {
+      return std::nullopt;
+    }
+    Point p = std::max(s.start(), t.start());
+    if (std::min(s.end(), t.end()) < p) {
+      return std::nullopt;
+    }
+    return p;
+  }
+
+  void report(size_t a, size_t b) {
+    size_t first = std::min(ids_[a], ids_[b]);
+    size_t second = std::max(ids_[a], ids_[b]);
+    if (reported_.contains(static_cast<uint64_t>(first) << 32 | second)) {
+      return;
+    }
+    std::optional<Point> p = meet(first, second);
+    if (!p || p->first < lo_ || p->first >= hi_) {
+      return;
+    }
+    reported_.insert(static_cast<uint64_t>(first) << 32 | second);
+    out_.push_back(SegmentIntersection{first, second, *p});
+  }
+
+  // Queues the intersection of two neighbours if it is still ahead.
+  void check(size_t a, size_t b) {
+    std::optional<Point> p =
+        originals_[ids_[a]].intersection(originals_[ids_[b]]);
+    if (p && event_ < *p) {
+      events_[*p];
+    }
+  }
+
+  bool endsAt(size_t s, const Point &p) const {
+    const Segment &segment = segments_[s];
+    return segment.isVertical()
+               ? segment.end().second <= p.second + tolerance_
+               : segment.end().first <= p.first + tolerance_;
+  }
+
+  void handle(const Point &p, std::vector<size_t> &starting) {
+    event_ = p;
+    std::vector<size_t> through;
+    for (auto it = status_.lower_bound(p.second);
+         it != status_.end() && height(*it) == p.second; ++it) {
+      through.push_back(*it);
+    }
+    std::vector<size_t> &all = starting;
+    all.insert(all.end(), through.begin(), through.end());
+    for (size_t i = 0; i < all.size(); ++i) {
+      for (size_t j = i + 1; j < all.size(); ++j) {
+        report(all[i], all[j]);
+      }
+    }
+    for (size_t s : through) {
+      status_.erase(where_[s]);
+    }
+    for (size_t s : all) {
+      if (!endsAt(s, p)) {
+        where_[s] = status_.insert(s).first;
+      }
+    }
+    auto lower = status_.lower_bound(p.second);
+    auto upper = status_.upper_bound(p.second);
+    if (lower == upper) {
+      if (lower != status_.begin() && lower != status_.end()) {
+        check(*std::prev(lower), *lower);
+      }
+      return;
+    }
+    if (lower != status_.begin()) {
+      check(*std::prev(lower), *lower);
+    }
+    if (upper != status_.end()) {
+      check(*std::prev(upper), *upper);
+    }
+  }
+
+public:
+  SegmentSweep(const std::vector<Segment> &segments,
+               const std::vector<Segment> &originals,
+               const std::vector<size_t> &ids,
+               std::vector<SegmentIntersection> &out,
+               double lo = -std::numeric_limits<double>::infinity(),
+               double hi = std::numeric_limits<double>::infinity())
+      : segments_(segments), originals_(originals), ids_(ids), lo_(lo), hi_(hi),
+        tolerance_(snapTolerance(originals)), status_(Below{this}),
+        where_(segments.size()), out_(out) {
+    for (size_t s = 0; s < segments.size(); ++s) {
+      events_[segments[s].start()].push_back(s);
+      events_[segments[s].end()];
+    }
+  }
+
+  void run() {
+    while (!events_.empty()) {
+      auto event = events_.extract(events_.begin());
+      handle(event.key(), event.mapped());
+    }
+  }
+};
+
+// Every pair of segments with a common point, in O((n + k) log n) for k
+// intersections. Collinear overlapping segments are reported where an
+// endpoint of one lies on the other.
+inline std::vector<SegmentIntersection>
+findIntersections(const std::vector<Segment> &segments) {
+  std::vector<size_t> ids(segments.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    ids[i] = i;
+  }
+  std::vector<SegmentIntersection> result;
+  SegmentSweep(segments, segments, ids, result).run();
+  return result;
+}
+
+// Same pairs as above, found by sweeping `slabs` vertical slabs with equal
+// numbers of starting points on separate threads. Segments are clipped to
+// each slab they cross, so long ones are swept more than once.
+inline std::vector<SegmentIntersection>
+findIntersections(const std::vector<Segment> &segments, size_t slabs) {
+  if (slabs <= 1 || segments.size() < 2 * slabs) {
+    return findIntersections(segments);
+  }
+  std::vector<double> xs;
+  for (const Segment &segment : segments) {
+    xs.push_back(segment.start().first);
+  }
+  std::sort(xs.begin(), xs.end());
+  std::vector<double> bounds{-std::numeric_limits<double>::infinity()};
+  for (size_t k = 1; k < slabs; ++k) {
+    if (xs[k * xs.size() / slabs] > bounds.back()) {
+      bounds.push_back(xs[k * xs.size() / slabs]);
+    }
+  }
+  bounds.push_back(std::numeric_limits<double>::infinity());
+
+  // Segments are clipped a little outside their slab, so that no clipped
+  // end lies on a boundary where it could hide an intersection.
+  double margin = 4 * snapTolerance(segments);
+  size_t count = bounds.size() - 1;
+  std::vector<std::vector<SegmentIntersection>> results(count);
+  std::vector<std::thread> threads;
+  for (size_t k = 0; k < count; ++k) {
+    threads.emplace_back([&, k] {
+      double left = bounds[k] - margin, right = bounds[k + 1] + margin;
+      std::vector<Segment> clipped;
+      std::vector<size_t> ids;
+      for (size_t i = 0; i < segments.size(); ++i) {
+        const Segment &segment = segments[i];
+        Point start = segment.start(), end = segment.end();
+        if (start.first > right || end.first < left) {
+          continue;
+        }
+        // Segments that only touch a clipping line stay whole.
+        if (start.first < left && end.first > left) {
+          start = Point{left, segment.yAt(left)};
+        }
+        if (end.first > right && start.first < right) {
+          end = Point{right, segment.yAt(right)};
+        }
+        clipped.emplace_back(start, end);
+        ids.push_back(i);
+      }
+      SegmentSweep(clipped, segments, ids, results[k], bounds[k],
+                   bounds[k + 1])
+          .run();
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  // Every pair is reported by the one slab holding its meeting point.
+  std::vector<SegmentIntersection> result;
+  for (std::vector<SegmentIntersection> &part : results) {
+    result.insert(result.end(), part.begin(), part.end());
+  }
+  return result;
+}
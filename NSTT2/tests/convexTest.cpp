@@ -0,0 +1,100 @@
+#include "../src/convex.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+double area(std::span<const Point> polygon) {
+  double twice = 0;
+  for (size_t i = 0; i < polygon.size(); ++i) {
+    const Point &p = polygon[i], &q = polygon[(i + 1) % polygon.size()];
+    twice += p.first * q.second - q.first * p.second;
+  }
+  return twice / 2;
+}
+
+} // namespace
+
+TEST(convexTest, hullSquare) {
+  std::vector<Point> points{{0, 0}, {2, 0}, {1, 1}, {2, 2}, {0, 2},
+                            {1, 0}, {0, 0}, {1, 2}, {2, 1}};
+  std::vector<Point> hull(points.size());
+  size_t count = convexHull(points, hull);
+  hull.resize(count);
+  EXPECT_EQ(hull, (std::vector<Point>{{0, 0}, {2, 0}, {2, 2}, {0, 2}}));
+
+  std::vector<Point> line{{0, 0}, {1, 1}, {2, 2}};
+  std::vector<Point> small(2);
+  EXPECT_THROW(convexHull(line, small), std::invalid_argument);
+  EXPECT_EQ(convexHull(line, hull), 2);
+}
+
+TEST(convexTest, hullAllVertices) {
+  // Every point is on the hull, so the chains need one slot more than the
+  // caller's buffer has.
+  std::vector<Point> points{{0, 0}, {1, -1}, {2, 0}};
+  std::vector<Point> hull(points.size());
+  ASSERT_EQ(convexHull(points, hull), 3);
+  EXPECT_EQ(hull, (std::vector<Point>{{0, 0}, {1, -1}, {2, 0}}));
+}
+
+TEST(convexTest, hullRandom) {
+  std::mt19937 random(5);
+  std::normal_distribution<double> coordinate(0, 100);
+  std::vector<Point> points;
+  for (int i = 0; i < 40000; ++i) {
+    points.emplace_back(coordinate(random), coordinate(random));
+  }
+  std::vector<Point> hull(points.size()), parallel(points.size());
+  size_t count = convexHull(points, hull);
+  ASSERT_EQ(convexHull(points, parallel, 4), count);
+  EXPECT_TRUE(std::equal(hull.begin(), hull.begin() + count,
+                         parallel.begin()));
+  for (size_t i = 0; i < count; ++i) {
+    const Point &p = hull[i], &q = hull[(i + 1) % count];
+    EXPECT_GT(robust::orientation(p, q, hull[(i + 2) % count]), 0);
+    for (const Point &r : points) {
+      ASSERT_GE(robust::orientation(p, q, r), 0);
+    }
+  }
+}
+
+TEST(convexTest, halfPlanes) {
+  // x >= 0, y >= 0, x <= 2, y <= 1 plus redundant x <= 5 and x + y <= 10.
+  std::vector<Line> planes{{1, 0, 0},  {0, 1, 0},  {-1, 0, 2},
+                           {0, -1, 1}, {-1, 0, 5}, {-1, -1, 10}};
+  std::vector<Point> vertices(planes.size());
+  size_t count = halfPlaneIntersection(planes, vertices);
+  ASSERT_EQ(count, 4);
+  EXPECT_DOUBLE_EQ(area(std::span<const Point>(vertices.data(), count)), 2);
+
+  // Cutting the corner (2, 1) off.
+  planes.emplace_back(-1, -1, 2.5);
+  vertices.resize(planes.size());
+  count = halfPlaneIntersection(planes, vertices);
+  ASSERT_EQ(count, 5);
+  EXPECT_DOUBLE_EQ(area(std::span<const Point>(vertices.data(), count)),
+                   2 - 0.125);
+
+  std::vector<Line> empty{{1, 0, -3}, {-1, 0, 2}, {0, 1, 0}, {0, -1, 1}};
+  EXPECT_EQ(halfPlaneIntersection(empty, vertices), 0);
+  std::vector<Line> open{{1, 0, 0}, {0, 1, 0}, {-1, 1, 5}};
+  EXPECT_EQ(halfPlaneIntersection(open, vertices), 0);
+}
+
+TEST(convexTest, halfPlanesTangentToCircle) {
+  // Tangents to the unit circle at n angles cut out a regular n-gon.
+  const double pi = std::acos(-1.0);
+  std::vector<Line> planes;
+  size_t n = 20000;
+  for (size_t i = 0; i < n; ++i) {
+    double t = 2 * pi * ((i * 7919) % n) / n;
+    planes.emplace_back(-std::cos(t), -std::sin(t), 1);
+  }
+  std::vector<Point> vertices(n);
+  size_t count = halfPlaneIntersection(planes, vertices, 4);
+  ASSERT_EQ(count, n);
+  EXPECT_NEAR(area(vertices), n * std::tan(pi / n), 1e-9);
+  EXPECT_NEAR(std::hypot(vertices[0].first, vertices[0].second),
+              1 / std::cos(pi / n), 1e-9);
+}
@@ -0,0 +1,81 @@
+#include "../src/lineBatch.h"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+// Lines at several angles, every other one through the origin, so that
+// a_ == 0 and b_ == 0 both show up in the vector lanes.
+std::vector<Line> sampleLines() {
+  std::vector<Line> lines;
+  for (int i = 0; i < 11; ++i) {
+    lines.emplace_back(i % 3 == 0 ? 0 : i, i % 3 == 1 ? 0 : 1 + i,
+                       i % 2 == 0 ? 0 : i);
+  }
+  return lines;
+}
+
+} // namespace
+
+TEST(lineBatchTest, matchesScalarParallel) {
+  std::vector<Line> first = sampleLines(), second;
+  for (size_t i = 0; i < first.size(); ++i) {
+    if (i == 3) {
+      second.emplace_back(1, 1, 0);
+    } else {
+      second.emplace_back(2 * first[i].a(), 2 * first[i].b(), 5);
+    }
+  }
+  LineBatch a(first), b(second);
+  std::vector<unsigned char> parallel(a.size());
+  a.isParallel(b, parallel);
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(parallel[i], first[i].isParallel(second[i])) << i;
+  }
+}
+
+TEST(lineBatchTest, intersection) {
+  std::vector<Line> first = sampleLines(), second;
+  for (size_t i = 0; i < first.size(); ++i) {
+    if (i == 5) {
+      second.push_back(first[i]);
+    } else {
+      second.emplace_back(first[i].b(), -first[i].a(), 1);
+    }
+  }
+  LineBatch a(first), b(second);
+  PointBatch points;
+  EXPECT_EQ(a.intersection(b, points), first.size() - 1);
+  ASSERT_EQ(points.size(), first.size());
+  for (size_t i = 0; i < first.size(); ++i) {
+    if (i == 5) {
+      EXPECT_TRUE(std::isnan(points.x[i]));
+      continue;
+    }
+    Point expected = first[i].intersection(second[i]);
+    EXPECT_NEAR(points.x[i], expected.first, 1e-12) << i;
+    EXPECT_NEAR(points.y[i], expected.second, 1e-12) << i;
+  }
+}
+
+TEST(lineBatchTest, belong) {
+  LineBatch lines(sampleLines());
+  std::vector<unsigned char> result(lines.size());
+  lines.belong(Point{0, 0}, result);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    EXPECT_EQ(result[i], lines[i].belong(Point{0, 0})) << i;
+  }
+
+  Line line{1, -1, 0};
+  PointBatch points;
+  for (int i = 0; i < 9; ++i) {
+    points.push_back(Point{i, i % 2 == 0 ? i : i + 1});
+  }
+  std::vector<unsigned char> onLine(points.size());
+  LineBatch::belong(line, points, onLine);
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_EQ(onLine[i], i % 2 == 0) << i;
+  }
+  EXPECT_THROW(LineBatch::belong(line, points, result),
+               std::invalid_argument);
+}
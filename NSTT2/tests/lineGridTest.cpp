@@ -0,0 +1,75 @@
+#include "../src/lineGrid.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+std::vector<Line> randomLines(std::mt19937 &random, size_t count) {
+  std::uniform_real_distribution<double> coefficient(-1, 1);
+  std::uniform_real_distribution<double> offset(-150, 150);
+  std::vector<Line> lines;
+  for (size_t i = 0; i < count; ++i) {
+    lines.emplace_back(coefficient(random), coefficient(random),
+                       offset(random));
+  }
+  return lines;
+}
+
+} // namespace
+
+TEST(lineGridTest, incident) {
+  LineGrid grid(Point{0, 0}, Point{10, 10}, 8);
+  grid.add(Line{1, -1, 0});
+  grid.add(Line{0, 1, -4});
+  grid.add(Line{1, 0, -4});
+  grid.add(Line{1, 1, 100});
+  EXPECT_EQ(grid.incident(Point{4, 4}), (std::vector<size_t>{0, 1, 2}));
+  EXPECT_EQ(grid.incident(Point{9, 4}), (std::vector<size_t>{1}));
+  EXPECT_EQ(grid.incident(Point{-50, -50}), (std::vector<size_t>{0, 3}));
+  EXPECT_TRUE(grid.incident(Point{1, 2}).empty());
+  EXPECT_THROW(LineGrid(Point{0, 0}, Point{0, 1}, 4), std::invalid_argument);
+}
+
+TEST(lineGridTest, matchesScan) {
+  std::mt19937 random(3);
+  LineGrid grid(Point{-100, -100}, Point{100, 100}, 32);
+  std::vector<Line> lines = randomLines(random, 500);
+  std::uniform_real_distribution<double> coordinate(-120, 120);
+  std::vector<Point> points;
+  for (int i = 0; i < 200; ++i) {
+    points.emplace_back(coordinate(random), coordinate(random));
+  }
+  // Points on some of the lines.
+  for (size_t i = 0; i < 50; ++i) {
+    const Line &line = lines[i];
+    double x = coordinate(random);
+    points.emplace_back(x, -(line.a() * x + line.c()) / line.b());
+  }
+
+  // Half of the lines first, to check incremental updates.
+  for (size_t i = 0; i < lines.size(); ++i) {
+    grid.add(lines[i]);
+    if (i + 1 != lines.size() / 2 && i + 1 != lines.size()) {
+      continue;
+    }
+    std::vector<std::optional<size_t>> nearest = grid.nearest(points, 3);
+    std::vector<std::vector<size_t>> incident = grid.incident(points, 3);
+    for (size_t k = 0; k < points.size(); ++k) {
+      const Point &p = points[k];
+      std::vector<size_t> on;
+      size_t closest = 0;
+      for (size_t j = 0; j <= i; ++j) {
+        if (lines[j].belong(p)) {
+          on.push_back(j);
+        }
+        if (distance(lines[j], p) < distance(lines[closest], p)) {
+          closest = j;
+        }
+      }
+      EXPECT_EQ(incident[k], on) << k;
+      ASSERT_TRUE(nearest[k]);
+      EXPECT_EQ(distance(lines[*nearest[k]], p), distance(lines[closest], p))
+          << k;
+    }
+  }
+}
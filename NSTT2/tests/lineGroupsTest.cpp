@@ -0,0 +1,119 @@
+#include "../src/lineGroups.h"
+#include <gtest/gtest.h>
+#include <random>
+
+TEST(lineGroupsTest, canonical) {
+  CanonicalLine line(Line{3, 4, 10});
+  CanonicalLine scaled(Line{-6, -8, -20});
+  EXPECT_DOUBLE_EQ(line.angle, scaled.angle);
+  EXPECT_DOUBLE_EQ(line.offset, 2);
+  EXPECT_DOUBLE_EQ(scaled.offset, 2);
+  EXPECT_DOUBLE_EQ(CanonicalLine(Line{-2, 0, 1}).angle, 0);
+  EXPECT_DOUBLE_EQ(CanonicalLine(Line{-2, 0, 1}).offset, -0.5);
+}
+
+TEST(lineGroupsTest, groups) {
+  std::vector<Line> lines{{1, 1, 0},   {2, 2, 5},   {-3, -3, 0}, {0, 1, 1},
+                          {0, -2, -2}, {1e-12, 1, 1}, {1, 0, 0},
+                          // Normals just on either side of the x axis.
+                          {1, 1e-12, 3}, {1, -1e-12, 3}};
+  LineGroups groups = groupLines(lines);
+  EXPECT_EQ(groups.parallelClasses, 3);
+  EXPECT_EQ(groups.parallelClass,
+            (std::vector<size_t>{0, 0, 0, 1, 1, 1, 2, 2, 2}));
+  EXPECT_EQ(groups.identicalClasses, 5);
+  EXPECT_EQ(groups.identicalClass,
+            (std::vector<size_t>{0, 1, 0, 2, 2, 2, 3, 4, 4}));
+  EXPECT_EQ(groups.intersectingPairs, 36 - 3 * 3);
+  EXPECT_EQ(groupLines(std::span<const Line>()).intersectingPairs, 0);
+  EXPECT_THROW(groupLines(lines, 0), std::invalid_argument);
+}
+
+TEST(lineGroupsTest, matchesPairwise) {
+  // Few directions and offsets, so most lines have parallel and identical
+  // partners, each randomly scaled.
+  std::mt19937 random(9);
+  std::uniform_int_distribution<int> pick(0, 11);
+  std::uniform_real_distribution<double> scale(0.5, 4);
+  std::vector<Line> lines;
+  for (int i = 0; i < 3000; ++i) {
+    double t = pick(random) * 0.25, offset = pick(random);
+    double k = scale(random) * (i % 2 == 0 ? 1 : -1);
+    lines.emplace_back(k * std::cos(t), k * std::sin(t), k * offset);
+  }
+  LineGroups groups = groupLines(lines);
+  uint64_t intersecting = 0;
+  for (size_t i = 0; i < lines.size(); i += 7) {
+    for (size_t j = 0; j < lines.size(); ++j) {
+      bool parallel = lines[i].isParallel(lines[j]) ||
+                      std::abs(CanonicalLine(lines[i]).angle -
+                               CanonicalLine(lines[j]).angle) < 1e-9;
+      ASSERT_EQ(groups.parallelClass[i] == groups.parallelClass[j], parallel);
+      bool same = parallel && std::abs(CanonicalLine(lines[i]).offset -
+                                       CanonicalLine(lines[j]).offset) < 1e-9;
+      ASSERT_EQ(groups.identicalClass[i] == groups.identicalClass[j], same);
+    }
+  }
+  for (size_t i = 0; i < lines.size(); ++i) {
+    for (size_t j = i + 1; j < lines.size(); ++j) {
+      intersecting += groups.parallelClass[i] != groups.parallelClass[j];
+    }
+  }
+  EXPECT_EQ(groups.intersectingPairs, intersecting);
+  EXPECT_EQ(groups.parallelClasses, 12);
+  EXPECT_EQ(groups.identicalClasses, 144);
+}
+
+TEST(lineGroupsTest, manyRandomLines) {
+  // Dense enough that chains of lines within the tolerance of each other
+  // span the whole circle of directions.
+  const size_t n = 500000;
+  const double pi = std::acos(-1.0);
+  std::mt19937 random(31);
+  std::uniform_real_distribution<double> direction(0, 2 * pi), offset(-5, 5);
+  std::vector<Line> lines;
+  for (size_t i = 0; i < n; ++i) {
+    double t = direction(random);
+    lines.emplace_back(std::cos(t), std::sin(t), offset(random));
+  }
+  LineGroups groups = groupLines(lines);
+
+  std::vector<double> low(groups.parallelClasses, pi);
+  std::vector<double> high(groups.parallelClasses, 0);
+  std::vector<uint64_t> size(groups.parallelClasses);
+  std::vector<double> angles;
+  for (size_t i = 0; i < n; ++i) {
+    size_t c = groups.parallelClass[i];
+    double angle = CanonicalLine(lines[i]).angle;
+    low[c] = std::min(low[c], angle);
+    high[c] = std::max(high[c], angle);
+    ++size[c];
+    angles.push_back(angle);
+  }
+  uint64_t grouped = 0;
+  for (size_t c = 0; c < groups.parallelClasses; ++c) {
+    // Classes may wrap around pi.
+    double span = std::min(high[c] - low[c], pi - (high[c] - low[c]));
+    ASSERT_LE(span, 2 * EPS);
+    grouped += size[c] * (size[c] - 1) / 2;
+  }
+  EXPECT_EQ(groups.intersectingPairs, uint64_t{n} * (n - 1) / 2 - grouped);
+
+  // Grouped pairs are at most those within two tolerances.
+  std::sort(angles.begin(), angles.end());
+  uint64_t close = 0;
+  for (size_t i = 0, j = 0; i < n; ++i) {
+    while (angles[i] - angles[j] > 2 * EPS) {
+      ++j;
+    }
+    close += i - j;
+  }
+  for (size_t i = 0; i < n && angles[i] + pi - angles.back() <= 2 * EPS;
+       ++i) {
+    for (size_t j = n; j-- > 0 && angles[i] + pi - angles[j] <= 2 * EPS;) {
+      ++close;
+    }
+  }
+  EXPECT_LE(grouped, close);
+  EXPECT_GT(grouped, 0);
+}
@@ -0,0 +1,72 @@
+#include "../src/predicates.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+// Coordinates are multiples of 2^-50 below 2^6, so 2^50 times each one is
+// an integer and the orientation determinant fits into 128 bits.
+__int128 scaled(double value) {
+  return static_cast<__int128>(std::ldexp(value, 50));
+}
+
+int exactOrientation(const Point &p, const Point &q, const Point &r) {
+  __int128 det = (scaled(q.first) - scaled(p.first)) *
+                     (scaled(r.second) - scaled(p.second)) -
+                 (scaled(q.second) - scaled(p.second)) *
+                     (scaled(r.first) - scaled(p.first));
+  return (det > 0) - (det < 0);
+}
+
+} // namespace
+
+TEST(predicatesTest, orientationSimple) {
+  EXPECT_EQ(robust::orientation(Point{0, 0}, Point{1, 0}, Point{0, 1}), 1);
+  EXPECT_EQ(robust::orientation(Point{0, 0}, Point{1, 0}, Point{0, -1}), -1);
+  EXPECT_EQ(robust::orientation(Point{0, 0}, Point{1, 1}, Point{3, 3}), 0);
+}
+
+TEST(predicatesTest, orientationNearlyCollinear) {
+  // Points on and next to the line y = x, a few ulps apart, where the
+  // plain double determinant often has the wrong sign.
+  std::mt19937 random(11);
+  std::uniform_int_distribution<int> ulps(-8, 8);
+  int naiveWrong = 0;
+  for (int i = 0; i < 2000; ++i) {
+    double x = 0.5 + ulps(random) * std::ldexp(1.0, -50);
+    Point p{x, 0.5 + ulps(random) * std::ldexp(1.0, -50)};
+    Point q{12, 12};
+    Point r{24 + ulps(random) * std::ldexp(1.0, -48), 24};
+    int expected = exactOrientation(p, q, r);
+    EXPECT_EQ(robust::orientation(p, q, r), expected) << i;
+    double naive = (q.first - p.first) * (r.second - p.second) -
+                   (q.second - p.second) * (r.first - p.first);
+    naiveWrong += ((naive > 0) - (naive < 0)) != expected;
+  }
+  EXPECT_GT(naiveWrong, 0);
+}
+
+TEST(predicatesTest, parallel) {
+  double big = std::ldexp(1.0, 27);
+  // (2^27 + 1)(2^27 - 1) rounds to 2^54 = 2^27 * 2^27.
+  Line l1{big + 1, big, 0};
+  Line l2{big, big - 1, 1};
+  EXPECT_EQ((big + 1) * (big - 1) - big * big, 0);
+  EXPECT_FALSE(robust::isParallel(l1, l2));
+  EXPECT_TRUE(robust::isParallel(Line{1, 2, 3}, Line{2, 4, 1231512}));
+  EXPECT_TRUE(robust::isParallel(Line{0, 3, 310}, Line{0, 5, 12351}));
+  EXPECT_FALSE(robust::isParallel(Line{0, 1, 1}, Line{1, 0, 1}));
+}
+
+TEST(predicatesTest, incidence) {
+  double big = std::ldexp(1.0, 53);
+  // big + 1 rounds back to big, so plain doubles see the point on the line.
+  Line line{1, 1, -big};
+  Point p{big, 1};
+  EXPECT_EQ(line.a() * p.first + line.b() * p.second + line.c(), 0);
+  EXPECT_EQ(robust::side(line, p), 1);
+  EXPECT_FALSE(robust::belong(line, p));
+  EXPECT_TRUE(robust::belong(line, Point{big, 0}));
+  EXPECT_EQ(robust::side(Line{0, 1, -1}, Point{5, 0}), -1);
+  EXPECT_TRUE(robust::belong(Line{8, 1.5, -14}, Point{1, 4}));
+}
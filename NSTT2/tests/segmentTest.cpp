@@ -0,0 +1,123 @@
+#include "../src/segment.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+std::vector<std::pair<size_t, size_t>>
+pairs(const std::vector<SegmentIntersection> &intersections) {
+  std::vector<std::pair<size_t, size_t>> result;
+  for (const SegmentIntersection &i : intersections) {
+    result.emplace_back(i.first, i.second);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+std::vector<std::pair<size_t, size_t>>
+bruteForce(const std::vector<Segment> &segments) {
+  std::vector<std::pair<size_t, size_t>> result;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    for (size_t j = i + 1; j < segments.size(); ++j) {
+      if (segments[i].intersection(segments[j])) {
+        result.emplace_back(i, j);
+      }
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(segmentTest, init) {
+  Segment s{Point{3, 1}, Point{1, 2}};
+  EXPECT_EQ(s.start(), (Point{1, 2}));
+  EXPECT_EQ(s.end(), (Point{3, 1}));
+  EXPECT_TRUE(s.line().belong(s.start()));
+  EXPECT_TRUE(s.line().belong(s.end()));
+  EXPECT_THROW(Segment(Point{1, 1}, Point{1, 1}), std::invalid_argument);
+}
+
+TEST(segmentTest, intersection) {
+  Segment a{Point{0, 0}, Point{2, 2}};
+  Segment b{Point{0, 2}, Point{2, 0}};
+  Segment c{Point{2, 2}, Point{3, 0}};
+  Segment d{Point{1, 0}, Point{3, 2}};
+  EXPECT_EQ(a.intersection(b), (Point{1, 1}));
+  EXPECT_EQ(a.intersection(c), (Point{2, 2}));
+  EXPECT_FALSE(a.intersection(d));
+  EXPECT_FALSE(a.intersection(Segment{Point{1, 1}, Point{4, 4}}));
+}
+
+TEST(segmentTest, sweepDegenerate) {
+  // Four segments through (1, 1), one of them vertical, a T-junction and
+  // a segment starting on another one.
+  std::vector<Segment> segments{
+      Segment{Point{0, 0}, Point{2, 2}}, Segment{Point{0, 2}, Point{2, 0}},
+      Segment{Point{1, 0}, Point{1, 3}}, Segment{Point{0, 1}, Point{3, 1}},
+      Segment{Point{1, 3}, Point{4, 3}}, Segment{Point{2, 1}, Point{2, 4}},
+      Segment{Point{5, 5}, Point{6, 6}}};
+  std::vector<SegmentIntersection> found = findIntersections(segments);
+  EXPECT_EQ(pairs(found), bruteForce(segments));
+  for (const SegmentIntersection &i : found) {
+    if (i.first < 4 && i.second < 4) {
+      EXPECT_NEAR(i.point.first, 1, 1e-12);
+      EXPECT_NEAR(i.point.second, 1, 1e-12);
+    }
+  }
+}
+
+TEST(segmentTest, sweepRandom) {
+  std::mt19937 random(7);
+  std::uniform_real_distribution<double> coordinate(0, 100);
+  std::uniform_real_distribution<double> offset(-10, 10);
+  std::vector<Segment> segments;
+  for (int i = 0; i < 400; ++i) {
+    Point p{coordinate(random), coordinate(random)};
+    segments.emplace_back(p, Point{p.first + offset(random),
+                                   p.second + offset(random)});
+  }
+  std::vector<std::pair<size_t, size_t>> expected = bruteForce(segments);
+  EXPECT_GT(expected.size(), 100);
+  EXPECT_EQ(pairs(findIntersections(segments)), expected);
+  EXPECT_EQ(pairs(findIntersections(segments, 4)), expected);
+}
+
+TEST(segmentTest, sweepSlabsOnGrid) {
+  // Integer endpoints put many intersections, shared endpoints and
+  // collinear overlaps right on the slab boundaries.
+  std::mt19937 random(197);
+  std::uniform_int_distribution<int> coordinate(0, 20), offset(-6, 6);
+  std::vector<Segment> segments;
+  for (int i = 0; i < 300; ++i) {
+    Point p(coordinate(random), coordinate(random));
+    Point q(i % 10 == 0 ? p.first : p.first + offset(random),
+            p.second + offset(random));
+    segments.emplace_back(p, q == p ? Point{q.first, q.second + 1} : q);
+  }
+  std::vector<std::pair<size_t, size_t>> expected =
+      pairs(findIntersections(segments));
+  EXPECT_EQ(pairs(findIntersections(segments, 4)), expected);
+  EXPECT_EQ(pairs(findIntersections(segments, 9)), expected);
+}
+
+TEST(segmentTest, sweepSmallCoordinates) {
+  // At these scales many segments pass within EPS of each other without
+  // meeting.
+  std::mt19937 random(23);
+  for (double scale : {0.05, 1e-3, 1e-6}) {
+    std::uniform_real_distribution<double> coordinate(0, scale);
+    std::uniform_real_distribution<double> offset(-scale / 5, scale / 5);
+    for (int run = 0; run < 50; ++run) {
+      std::vector<Segment> segments;
+      for (int i = 0; i < 30; ++i) {
+        Point p{coordinate(random), coordinate(random)};
+        segments.emplace_back(p, Point{p.first + offset(random),
+                                       p.second + offset(random)});
+      }
+      std::vector<std::pair<size_t, size_t>> expected = bruteForce(segments);
+      ASSERT_EQ(pairs(findIntersections(segments)), expected);
+      ASSERT_EQ(pairs(findIntersections(segments, 3)), expected);
+    }
+  }
+}
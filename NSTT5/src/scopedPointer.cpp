@@ -1,28 +1,111 @@
-template <typename T> class ScopedPointerTransfer {
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Storage for an allocator. An empty one becomes a base class, so with a
+// stateless allocator a scoped pointer is as small as a raw pointer.
+template <typename Allocator,
+          bool = std::is_empty_v<Allocator> && !std::is_final_v<Allocator>>
+class AllocatorStorage : private Allocator {
+public:
+  AllocatorStorage(const Allocator &allocator) : Allocator(allocator) {}
+
+  Allocator &allocator() { return *this; }
+  const Allocator &allocator() const { return *this; }
+};
+
+template <typename Allocator> class AllocatorStorage<Allocator, false> {
+  Allocator allocator_;
+
+public:
+  AllocatorStorage(const Allocator &allocator) : allocator_(allocator) {}
+
+  Allocator &allocator() { return allocator_; }
+  const Allocator &allocator() const { return allocator_; }
+};
+
+// A pointer to one object owned through a standard allocator: the object is
+// built with allocate and construct and released with destroy and
+// deallocate. With the default std::allocator this matches new and delete,
+// so raw pointers from `new T` can still be adopted.
+template <typename T, typename Allocator>
+class AllocatedPointer : protected AllocatorStorage<Allocator> {
+  using Traits = std::allocator_traits<Allocator>;
+
+protected:
   T *pointer;
 
+  AllocatedPointer(T *raw, const Allocator &allocator)
+      : AllocatorStorage<Allocator>(allocator), pointer(raw) {}
+
+  void release() {
+    if (pointer) {
+      Traits::destroy(this->allocator(), pointer);
+      Traits::deallocate(this->allocator(), pointer, 1);
+      pointer = nullptr;
+    }
+  }
+
+  // Takes over the object of `other`. An allocator that does not propagate
+  // on move and differs from ours cannot free it, so it is moved instead.
+  void moveFrom(AllocatedPointer &other) {
+    release();
+    if constexpr (Traits::propagate_on_container_move_assignment::value) {
+      this->allocator() = std::move(other.allocator());
+    } else if (this->allocator() != other.allocator()) {
+      if (other.pointer) {
+        pointer = create(this->allocator(), std::move(*other.pointer));
+        other.release();
+      }
+      return;
+    }
+    pointer = other.pointer;
+    other.pointer = nullptr;
+  }
+
 public:
-  ScopedPointerTransfer(T *raw) : pointer(raw) {}
+  template <typename... Args>
+  static T *create(Allocator &allocator, Args &&...args) {
+    T *raw = std::to_address(Traits::allocate(allocator, 1));
+    try {
+      Traits::construct(allocator, raw, std::forward<Args>(args)...);
+    } catch (...) {
+      Traits::deallocate(allocator, raw, 1);
+      throw;
+    }
+    return raw;
+  }
+};
+
+template <typename T, typename Allocator = std::allocator<T>>
+class ScopedPointerTransfer : public AllocatedPointer<T, Allocator> {
+  using Base = AllocatedPointer<T, Allocator>;
+  using Base::pointer;
 
-  ~ScopedPointerTransfer() { delete pointer; }
+public:
+  // `raw` must come from `allocator`; with the default one, from new.
+  ScopedPointerTransfer(T *raw, const Allocator &allocator = Allocator())
+      : Base(raw, allocator) {}
+
+  ~ScopedPointerTransfer() { this->release(); }
 
   ScopedPointerTransfer(const ScopedPointerTransfer &other) = delete;
   ScopedPointerTransfer &operator=(const ScopedPointerTransfer &other) = delete;
 
   ScopedPointerTransfer(ScopedPointerTransfer &&other)
-      : pointer(other.pointer) {
+      : Base(other.pointer, other.allocator()) {
     other.pointer = nullptr;
   }
-  ScopedPointerTransfer<T> &operator=(ScopedPointerTransfer<T> &&other) {
+  ScopedPointerTransfer &operator=(ScopedPointerTransfer &&other) {
     if (this != &other) {
-      delete pointer;
-      pointer = other.pointer;
-      other.pointer = nullptr;
+      this->moveFrom(other);
     }
     return *this;
   }
 
-  bool isEmpty() { return !pointer; }
+  bool isEmpty() const { return !pointer; }
 
   T &operator*() { return *pointer; }
   const T &operator*() const { return *pointer; }
@@ -31,39 +114,253 @@ public:
   const T *operator->() const { return pointer; }
 };
 
-template <typename T> class ScopedPointerDeep {
-  T *pointer;
+template <typename T, typename Allocator = std::allocator<T>>
+class ScopedPointerDeep : public AllocatedPointer<T, Allocator> {
+  using Base = AllocatedPointer<T, Allocator>;
+  using Base::pointer;
+  using Traits = std::allocator_traits<Allocator>;
 
 public:
-  ScopedPointerDeep(T *raw) : pointer(raw) {}
+  // `raw` must come from `allocator`; with the default one, from new.
+  ScopedPointerDeep(T *raw, const Allocator &allocator = Allocator())
+      : Base(raw, allocator) {}
 
-  ~ScopedPointerDeep() { delete pointer; }
+  ~ScopedPointerDeep() { this->release(); }
 
+  // Copies are cloned through the allocator of the copy.
   ScopedPointerDeep(const ScopedPointerDeep &other)
-      : pointer(new T(*other.pointer)) {}
+      : Base(nullptr, Traits::select_on_container_copy_construction(
+                          other.allocator())) {
+    if (other.pointer) {
+      pointer = Base::create(this->allocator(), *other.pointer);
+    }
+  }
   ScopedPointerDeep &operator=(const ScopedPointerDeep &other) {
     if (this != &other) {
-      delete pointer;
-      pointer = new T(*other.pointer);
+      T *copy = other.pointer ? Base::create(this->allocator(), *other.pointer)
+                              : nullptr;
+      this->release();
+      pointer = copy;
     }
     return *this;
   }
 
-  ScopedPointerDeep(ScopedPointerDeep &&other) : pointer(other.pointer) {
+  ScopedPointerDeep(ScopedPointerDeep &&other)
+      : Base(other.pointer, other.allocator()) {
     other.pointer = nullptr;
   }
-  ScopedPointerTransfer<T> &operator=(ScopedPointerTransfer<T> &&other) {
+  ScopedPointerDeep &operator=(ScopedPointerDeep &&other) {
     if (this != &other) {
-      delete pointer;
-      pointer = other.pointer;
-      other.pointer = nullptr;
+      this->moveFrom(other);
     }
     return *this;
   }
 
+  bool isEmpty() const { return !pointer; }
+
   T &operator*() { return *pointer; }
   const T &operator*() const { return *pointer; }
 
   T *operator->() { return pointer; }
   const T *operator->() const { return pointer; }
-};
\ No newline at end of file
+};
+
+// Builds a T from `args` in memory taken from `allocator`, for objects that
+// live in a pool or an arena. The pointer hands the memory back to it.
+template <typename T, typename Allocator, typename... Args>
+ScopedPointerTransfer<
+    T, typename std::allocator_traits<Allocator>::template rebind_alloc<T>>
+make_scoped(const Allocator &allocator, Args &&...args) {
+  using Rebound =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+  Rebound rebound(allocator);
+  T *raw = AllocatedPointer<T, Rebound>::create(rebound,
+                                                std::forward<Args>(args)...);
+  return ScopedPointerTransfer<T, Rebound>(raw, rebound);
+}
+
+// As make_scoped, for a pointer that deep-copies through the same
+// allocator.
+template <typename T, typename Allocator, typename... Args>
+ScopedPointerDeep<
+    T, typename std::allocator_traits<Allocator>::template rebind_alloc<T>>
+make_scoped_deep(const Allocator &allocator, Args &&...args) {
+  using Rebound =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+  Rebound rebound(allocator);
+  T *raw = AllocatedPointer<T, Rebound>::create(rebound,
+                                                std::forward<Args>(args)...);
+  return ScopedPointerDeep<T, Rebound>(raw, rebound);
+}
+
+// Reference count operations. A plain integer is cheapest; an atomic one
+// lets copies of the same object be used and dropped from several threads.
+template <typename Count> struct RefCount {
+  static void increment(Count &count) { ++count; }
+  // True when the last reference is gone.
+  static bool decrement(Count &count) { return --count == 0; }
+  static size_t load(const Count &count) { return count; }
+};
+
+template <typename Integer> struct RefCount<std::atomic<Integer>> {
+  static void increment(std::atomic<Integer> &count) {
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+  static bool decrement(std::atomic<Integer> &count) {
+    return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+  static size_t load(const std::atomic<Integer> &count) {
+    return count.load(std::memory_order_acquire);
+  }
+};
+
+// The shared object and its count, in a single allocation.
+template <typename T, typename Count> struct CowBlock {
+  Count count;
+  // Cleared once a non-const reference to `value` has been handed out.
+  bool shareable = true;
+  T value;
+
+  template <typename... Args>
+  CowBlock(Args &&...args) : count(1), value(std::forward<Args>(args)...) {}
+};
+
+// A deep pointer that copies lazily: copies share the object, and it is
+// cloned only when a shared copy is first accessed through a non-const
+// pointer, so copies cost O(1) until they are changed. Read through a
+// const pointer (std::as_const) to avoid the clone. A non-const reference
+// may be kept and written through later, so once one has been handed out
+// the object is never shared again and later copies clone it. The count is
+// a plain size_t; pass std::atomic<size_t> as Count to share between
+// threads.
+template <typename T, typename Allocator = std::allocator<T>,
+          typename Count = size_t>
+class ScopedPointerCow
+    : public AllocatedPointer<
+          CowBlock<T, Count>, typename std::allocator_traits<
+                                  Allocator>::template rebind_alloc<
+                                  CowBlock<T, Count>>> {
+  using Block = CowBlock<T, Count>;
+  using BlockAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Block>;
+  using Base = AllocatedPointer<Block, BlockAllocator>;
+  using Base::pointer;
+  using Traits = std::allocator_traits<BlockAllocator>;
+
+  void drop() {
+    if (pointer && !RefCount<Count>::decrement(pointer->count)) {
+      pointer = nullptr;
+    }
+    this->release();
+  }
+
+  // Shares the object of `other` when it is shareable and our allocator
+  // can free it, and clones it otherwise. The pointer must be empty.
+  void share(const ScopedPointerCow &other) {
+    if (!other.pointer) {
+      return;
+    }
+    if (other.pointer->shareable && this->allocator() == other.allocator()) {
+      RefCount<Count>::increment(other.pointer->count);
+      pointer = other.pointer;
+    } else {
+      pointer = Base::create(this->allocator(), other.pointer->value);
+    }
+  }
+
+  // Gives this pointer an object of its own before a non-const reference
+  // to it is handed out, and stops sharing it from then on.
+  void detach() {
+    if (pointer && RefCount<Count>::load(pointer->count) > 1) {
+      Block *copy =
+          Base::create(this->allocator(), std::as_const(pointer->value));
+      drop();
+      pointer = copy;
+    }
+    if (pointer) {
+      pointer->shareable = false;
+    }
+  }
+
+public:
+  // Builds the object from `args` in memory taken from `allocator`.
+  template <typename... Args>
+  ScopedPointerCow(std::in_place_t, const Allocator &allocator,
+                   Args &&...args)
+      : Base(nullptr, BlockAllocator(allocator)) {
+    pointer = Base::create(this->allocator(), std::forward<Args>(args)...);
+  }
+
+  ~ScopedPointerCow() { drop(); }
+
+  ScopedPointerCow(const ScopedPointerCow &other)
+      : Base(nullptr, Traits::select_on_container_copy_construction(
+                          other.allocator())) {
+    share(other);
+  }
+  ScopedPointerCow &operator=(const ScopedPointerCow &other) {
+    if (pointer != other.pointer) {
+      // Held until the end, in case `other` lives inside our object.
+      ScopedPointerCow old(std::move(*this));
+      if constexpr (Traits::propagate_on_container_copy_assignment::value) {
+        this->allocator() = other.allocator();
+      }
+      share(other);
+    }
+    return *this;
+  }
+
+  ScopedPointerCow(ScopedPointerCow &&other)
+      : Base(other.pointer, other.allocator()) {
+    other.pointer = nullptr;
+  }
+  ScopedPointerCow &operator=(ScopedPointerCow &&other) {
+    if (this != &other) {
+      ScopedPointerCow old(std::move(*this));
+      if constexpr (Traits::propagate_on_container_move_assignment::value) {
+        this->allocator() = std::move(other.allocator());
+      }
+      if (this->allocator() == other.allocator()) {
+        pointer = other.pointer;
+        other.pointer = nullptr;
+      } else {
+        share(other);
+        other.drop();
+      }
+    }
+    return *this;
+  }
+
+  bool isEmpty() const { return !pointer; }
+
+  // Number of pointers sharing the object.
+  size_t useCount() const {
+    return pointer ? RefCount<Count>::load(pointer->count) : 0;
+  }
+
+  T &operator*() {
+    detach();
+    return pointer->value;
+  }
+  const T &operator*() const { return pointer->value; }
+
+  T *operator->() {
+    detach();
+    return &pointer->value;
+  }
+  const T *operator->() const { return &pointer->value; }
+};
+
+// As make_scoped, for a copy-on-write pointer. Pass std::atomic<size_t> as
+// Count for copies shared between threads.
+template <typename T, typename Count = size_t, typename Allocator,
+          typename... Args>
+ScopedPointerCow<
+    T, typename std::allocator_traits<Allocator>::template rebind_alloc<T>,
+    Count>
+make_scoped_cow(const Allocator &allocator, Args &&...args) {
+  using Rebound =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+  return ScopedPointerCow<T, Rebound, Count>(
+      std::in_place, Rebound(allocator), std::forward<Args>(args)...);
+}
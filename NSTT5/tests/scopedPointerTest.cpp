@@ -1,5 +1,8 @@
 #include "../src/scopedPointer.cpp"
 #include <gtest/gtest.h>
+#include <memory_resource>
+#include <thread>
+#include <vector>
 
 class TestClass {
   size_t size;
@@ -50,6 +53,177 @@ TEST(ScopedPointer, deepCopyTest2) {
     EXPECT_EQ(spt->getSize(), newSpt->getSize());
 }
 
+// Counts what is taken from it and given back.
+struct Pool {
+  size_t allocated = 0, freed = 0;
+};
+
+template <typename T> struct PoolAllocator {
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+
+  Pool *pool;
+
+  PoolAllocator(Pool &pool) : pool(&pool) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool) {}
+
+  T *allocate(size_t n) {
+    ++pool->allocated;
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T *p, size_t n) {
+    ++pool->freed;
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  bool operator==(const PoolAllocator &other) const {
+    return pool == other.pool;
+  }
+};
+
+// Stateless, so it must not make the pointer any larger.
+template <typename T> struct EmptyAllocator : std::allocator<T> {
+  template <typename U> struct rebind {
+    using other = EmptyAllocator<U>;
+  };
+  EmptyAllocator() = default;
+  template <typename U> EmptyAllocator(const EmptyAllocator<U> &) {}
+};
+
+TEST(ScopedPointer, emptyAllocatorSizeTest) {
+    EXPECT_EQ(sizeof(ScopedPointerTransfer<TestClass>), sizeof(TestClass *));
+    EXPECT_EQ(sizeof(ScopedPointerDeep<TestClass>), sizeof(TestClass *));
+    EXPECT_EQ(sizeof(ScopedPointerTransfer<int, EmptyAllocator<int>>),
+              sizeof(int *));
+    EXPECT_EQ(sizeof(ScopedPointerDeep<int, EmptyAllocator<int>>),
+              sizeof(int *));
+}
+
+TEST(ScopedPointer, poolTransferTest) {
+    Pool pool;
+    {
+        auto spt = make_scoped<TestClass>(PoolAllocator<char>(pool), 42);
+        EXPECT_EQ(spt->getSize(), 42);
+        EXPECT_EQ(pool.allocated, 1);
+
+        auto newSpt = make_scoped<TestClass>(PoolAllocator<char>(pool), 15);
+        newSpt = std::move(spt);
+        EXPECT_TRUE(spt.isEmpty());
+        EXPECT_EQ(newSpt->getSize(), 42);
+        EXPECT_EQ(pool.freed, 1);
+    }
+    EXPECT_EQ(pool.allocated, 2);
+    EXPECT_EQ(pool.freed, 2);
+}
+
+TEST(ScopedPointer, poolDeepCopyTest) {
+    Pool pool;
+    {
+        auto spd = make_scoped_deep<TestClass>(PoolAllocator<char>(pool), 42);
+        ScopedPointerDeep<TestClass, PoolAllocator<TestClass>> newSpd{spd};
+        EXPECT_EQ(newSpd->getSize(), 42);
+        EXPECT_EQ(pool.allocated, 2);
+
+        auto other = make_scoped_deep<TestClass>(PoolAllocator<char>(pool), 7);
+        newSpd = other;
+        EXPECT_EQ(newSpd->getSize(), 7);
+        EXPECT_EQ(pool.allocated, 4);
+        EXPECT_EQ(pool.freed, 1);
+    }
+    EXPECT_EQ(pool.freed, 4);
+}
+
+TEST(ScopedPointer, arenaMoveTest) {
+    // Polymorphic allocators do not propagate, so moving between arenas
+    // moves the object instead of its memory.
+    std::pmr::monotonic_buffer_resource first, second;
+    using Arena = std::pmr::polymorphic_allocator<TestClass>;
+    auto spt = make_scoped<TestClass>(Arena(&first), 42);
+    auto same = make_scoped<TestClass>(Arena(&first), 15);
+    auto other = make_scoped<TestClass>(Arena(&second), 15);
+
+    TestClass *raw = &*spt;
+    same = std::move(spt);
+    EXPECT_EQ(&*same, raw);
+    other = std::move(same);
+    EXPECT_NE(&*other, raw);
+    EXPECT_TRUE(same.isEmpty());
+    EXPECT_EQ(other->getSize(), 42);
+}
+
+TEST(ScopedPointer, cowCopyTest) {
+    auto spc = make_scoped_cow<TestClass>(std::allocator<TestClass>(), 42);
+    ScopedPointerCow<TestClass> newSpc{spc};
+    EXPECT_EQ(&*std::as_const(spc), &*std::as_const(newSpc));
+    EXPECT_EQ(spc.useCount(), 2);
+
+    *newSpc = TestClass{15};
+    EXPECT_EQ(spc->getSize(), 42);
+    EXPECT_EQ(newSpc->getSize(), 15);
+    EXPECT_EQ(spc.useCount(), 1);
+    EXPECT_EQ(newSpc.useCount(), 1);
+}
+
+TEST(ScopedPointer, cowKeptReferenceTest) {
+    auto spc = make_scoped_cow<TestClass>(std::allocator<TestClass>(), 42);
+    TestClass &kept = *spc;
+    ScopedPointerCow<TestClass> copy{spc};
+    EXPECT_NE(&*std::as_const(copy), &kept);
+    kept = TestClass{15};
+    EXPECT_EQ(std::as_const(copy)->getSize(), 42);
+    EXPECT_EQ(std::as_const(spc)->getSize(), 15);
+
+    // The copy was never written through, so it is still shared.
+    ScopedPointerCow<TestClass> another{copy};
+    EXPECT_EQ(copy.useCount(), 2);
+}
+
+TEST(ScopedPointer, cowAssignTest) {
+    Pool pool;
+    {
+        auto spc = make_scoped_cow<TestClass>(PoolAllocator<char>(pool), 42);
+        auto newSpc = make_scoped_cow<TestClass>(PoolAllocator<char>(pool), 7);
+        newSpc = spc;
+        EXPECT_EQ(pool.freed, 1);
+        EXPECT_EQ(std::as_const(newSpc)->getSize(), 42);
+
+        auto moved = std::move(newSpc);
+        EXPECT_TRUE(newSpc.isEmpty());
+        EXPECT_EQ(moved.useCount(), 2);
+        EXPECT_EQ(pool.allocated, 2);
+
+        // A unique object is changed in place.
+        spc = make_scoped_cow<TestClass>(PoolAllocator<char>(pool), 15);
+        *moved = TestClass{16};
+        EXPECT_EQ(pool.allocated, 3);
+        EXPECT_EQ(spc->getSize(), 15);
+        EXPECT_EQ(moved->getSize(), 16);
+    }
+    EXPECT_EQ(pool.freed, 3);
+}
+
+TEST(ScopedPointer, cowAtomicTest) {
+    auto spc = make_scoped_cow<std::vector<int>, std::atomic<size_t>>(
+        std::allocator<int>(), 1000, 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([copy = spc]() mutable {
+            for (int i = 0; i < 1000; ++i) {
+                auto local = copy;
+                if (i % 100 == 0) {
+                    (*local)[0] = i;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(spc.useCount(), 1);
+    EXPECT_EQ((*spc)[0], 1);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,372 @@
+#include "arena.h"
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kInitialTable = 64;
+
+size_t hashNode(const ExpressionArena::Node &node) {
+  constexpr uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+  uint64_t h = static_cast<uint64_t>(node.kind);
+  h = (h ^ static_cast<uint32_t>(node.value)) * kMul;
+  h = (h ^ node.left) * kMul;
+  h = (h ^ node.right) * kMul;
+  return h ^ (h >> 29);
+}
+
+bool sameNode(const ExpressionArena::Node &a, const ExpressionArena::Node &b) {
+  return a.kind == b.kind && a.value == b.value && a.left == b.left &&
+         a.right == b.right;
+}
+
+char signOf(Expression::Kind kind) {
+  switch (kind) {
+  case Expression::Kind::Add:
+    return '+';
+  case Expression::Kind::Sub:
+    return '-';
+  case Expression::Kind::Mult:
+    return '*';
+  case Expression::Kind::Div:
+    return '/';
+  case Expression::Kind::Exponent:
+    return '^';
+  default:
+    throw std::invalid_argument("Not a binary operation");
+  }
+}
+
+} // namespace
+
+ExpressionArena::ExpressionArena() : table(kInitialTable, kEmpty) {}
+
+ExpressionArena::Id ExpressionArena::intern(const Node &node) {
+  if ((nodes.size() + 1) * 2 > table.size()) {
+    std::vector<Id> grown(table.size() * 2, kEmpty);
+    size_t mask = grown.size() - 1;
+    for (Id id = 0; id < nodes.size(); ++id) {
+      size_t i = hashNode(nodes[id]) & mask;
+      while (grown[i] != kEmpty) {
+        i = (i + 1) & mask;
+      }
+      grown[i] = id;
+    }
+    table.swap(grown);
+  }
+  size_t mask = table.size() - 1;
+  size_t i = hashNode(node) & mask;
+  while (table[i] != kEmpty) {
+    if (sameNode(nodes[table[i]], node)) {
+      return table[i];
+    }
+    i = (i + 1) & mask;
+  }
+  table[i] = nodes.size();
+  nodes.push_back(node);
+  return table[i];
+}
+
+ExpressionArena::Id ExpressionArena::constant(int value) {
+  return intern({Kind::Val, value, 0, 0});
+}
+
+ExpressionArena::Id ExpressionArena::variable(std::string_view name) {
+  auto it = nameIndex.find(name);
+  if (it == nameIndex.end()) {
+    it = nameIndex.emplace(name, names.size()).first;
+    names.emplace_back(name);
+  }
+  return intern({Kind::Var, it->second, 0, 0});
+}
+
+ExpressionArena::Id ExpressionArena::make(Kind kind, Id l, Id r) {
+  if (nodes[l].kind == Kind::Val && nodes[r].kind == Kind::Val) {
+    int a = nodes[l].value, b = nodes[r].value, folded;
+    switch (kind) {
+    case Kind::Add:
+      if (!__builtin_add_overflow(a, b, &folded)) {
+        return constant(folded);
+      }
+      break;
+    case Kind::Sub:
+      if (!__builtin_sub_overflow(a, b, &folded)) {
+        return constant(folded);
+      }
+      break;
+    case Kind::Mult:
+      if (!__builtin_mul_overflow(a, b, &folded)) {
+        return constant(folded);
+      }
+      break;
+    case Kind::Div:
+      if (b != 0 && !(a == std::numeric_limits<int>::min() && b == -1) &&
+          a % b == 0) {
+        return constant(a / b);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  switch (kind) {
+  case Kind::Add:
+    if (isConstant(l, 0)) {
+      return r;
+    }
+    if (isConstant(r, 0)) {
+      return l;
+    }
+    break;
+  case Kind::Sub:
+    if (isConstant(r, 0)) {
+      return l;
+    }
+    if (l == r) {
+      return constant(0);
+    }
+    break;
+  case Kind::Mult:
+    if (isConstant(l, 0) || isConstant(r, 0)) {
+      return constant(0);
+    }
+    if (isConstant(l, 1)) {
+      return r;
+    }
+    if (isConstant(r, 1)) {
+      return l;
+    }
+    break;
+  case Kind::Div:
+    if (isConstant(r, 1)) {
+      return l;
+    }
+    if (isConstant(l, 0) && !isConstant(r, 0)) {
+      return constant(0);
+    }
+    break;
+  case Kind::Exponent:
+    if (isConstant(r, 0)) {
+      return constant(1);
+    }
+    if (isConstant(r, 1)) {
+      return l;
+    }
+    break;
+  default:
+    throw std::invalid_argument("Not a binary operation");
+  }
+  return intern({kind, 0, l, r});
+}
+
+ExpressionArena::Id ExpressionArena::ln(Id argument) {
+  if (isConstant(argument, 1)) {
+    return constant(0);
+  }
+  return intern({Kind::Ln, 0, argument, 0});
+}
+
+ExpressionArena::Id ExpressionArena::diff(Id root,
+                                          const std::string &variable) {
+  auto it = nameIndex.find(variable);
+  if (it == nameIndex.end()) {
+    return constant(0);
+  }
+  // As in toExpression: children precede their parents, so the reachable
+  // nodes are differentiated in id order once they are marked, without any
+  // stack. Nodes built on the way get ids above root and are never visited.
+  std::vector<bool> reachable(root + 1);
+  reachable[root] = true;
+  for (Id id = root + 1; id-- > 0;) {
+    const Node &n = nodes[id];
+    if (!reachable[id] || n.kind == Kind::Val || n.kind == Kind::Var) {
+      continue;
+    }
+    reachable[n.left] = true;
+    if (n.kind != Kind::Ln) {
+      reachable[n.right] = true;
+    }
+  }
+  std::vector<Id> memo(root + 1, kEmpty);
+  for (Id id = 0; id <= root; ++id) {
+    if (reachable[id]) {
+      memo[id] = derivative(id, it->second, memo);
+    }
+  }
+  return memo[root];
+}
+
+ExpressionArena::Id
+ExpressionArena::derivative(Id id, int variable, const std::vector<Id> &memo) {
+  // Copy: building nodes may reallocate the node array.
+  Node n = nodes[id];
+  switch (n.kind) {
+  case Kind::Val:
+    return constant(0);
+  case Kind::Var:
+    return constant(n.value == variable ? 1 : 0);
+  case Kind::Add:
+    return make(Kind::Add, memo[n.left], memo[n.right]);
+  case Kind::Sub:
+    return make(Kind::Sub, memo[n.left], memo[n.right]);
+  case Kind::Mult:
+    return make(Kind::Add, make(Kind::Mult, memo[n.left], n.right),
+                make(Kind::Mult, n.left, memo[n.right]));
+  case Kind::Div:
+    return make(Kind::Div,
+                make(Kind::Sub, make(Kind::Mult, memo[n.left], n.right),
+                     make(Kind::Mult, n.left, memo[n.right])),
+                make(Kind::Mult, n.right, n.right));
+  case Kind::Exponent: {
+    Id dl = memo[n.left];
+    Id dr = memo[n.right];
+    if (isConstant(dr, 0)) {
+      Id n_minus_one = make(Kind::Sub, n.right, constant(1));
+      return make(Kind::Mult,
+                  make(Kind::Mult, n.right,
+                       make(Kind::Exponent, n.left, n_minus_one)),
+                  dl);
+    }
+    if (isConstant(dl, 0)) {
+      return make(Kind::Mult, id, make(Kind::Mult, ln(n.left), dr));
+    }
+    return make(Kind::Mult, id,
+                make(Kind::Add, make(Kind::Mult, dr, ln(n.left)),
+                     make(Kind::Div, make(Kind::Mult, n.right, dl), n.left)));
+  }
+  case Kind::Ln:
+    return make(Kind::Div, memo[n.left], n.left);
+  }
+  throw std::invalid_argument("Unknown expression kind");
+}
+
+ExpressionArena::Id
+ExpressionArena::import(const std::shared_ptr<Expression> &expression) {
+  // Post-order with an explicit stack so that very deep trees cannot
+  // overflow the call stack. A node is expanded first and interned once its
+  // children have ids.
+  std::unordered_map<const Expression *, Id> memo;
+  std::vector<std::pair<const Expression *, bool>> stack{
+      {expression.get(), false}};
+  while (!stack.empty()) {
+    auto [e, expanded] = stack.back();
+    if (memo.count(e)) {
+      stack.pop_back();
+      continue;
+    }
+    if (!expanded) {
+      stack.back().second = true;
+      if (e->isBinary()) {
+        const Binary &b = static_cast<const Binary &>(*e);
+        stack.push_back({b.getRight().get(), false});
+        stack.push_back({b.getLeft().get(), false});
+      } else if (e->getKind() == Kind::Ln) {
+        stack.push_back(
+            {static_cast<const Ln &>(*e).getArgument().get(), false});
+      }
+      continue;
+    }
+    stack.pop_back();
+    Id id;
+    if (e->isBinary()) {
+      const Binary &b = static_cast<const Binary &>(*e);
+      id = intern({b.getKind(), 0, memo.at(b.getLeft().get()),
+                   memo.at(b.getRight().get())});
+    } else if (e->getKind() == Kind::Ln) {
+      id = ln(memo.at(static_cast<const Ln &>(*e).getArgument().get()));
+    } else if (e->getKind() == Kind::Val) {
+      id = constant(static_cast<const Val &>(*e).getValue());
+    } else {
+      id = variable(static_cast<const Var &>(*e).getName());
+    }
+    memo.emplace(e, id);
+  }
+  return memo.at(expression.get());
+}
+
+std::shared_ptr<Expression> ExpressionArena::toExpression(Id root) const {
+  // Children are always built before their parents, so every child id is
+  // smaller than its parent's. One pass downwards marks the nodes reachable
+  // from the root and one pass upwards builds them, without any stack.
+  std::vector<bool> reachable(root + 1);
+  reachable[root] = true;
+  for (Id id = root + 1; id-- > 0;) {
+    const Node &n = nodes[id];
+    if (!reachable[id] || n.kind == Kind::Val || n.kind == Kind::Var) {
+      continue;
+    }
+    reachable[n.left] = true;
+    if (n.kind != Kind::Ln) {
+      reachable[n.right] = true;
+    }
+  }
+  std::vector<std::shared_ptr<Expression>> built(root + 1);
+  for (Id id = 0; id <= root; ++id) {
+    if (!reachable[id]) {
+      continue;
+    }
+    const Node &n = nodes[id];
+    if (n.kind == Kind::Val) {
+      built[id] = std::make_shared<Val>(n.value);
+    } else if (n.kind == Kind::Var) {
+      built[id] = std::make_shared<Var>(names[n.value]);
+    } else if (n.kind == Kind::Ln) {
+      built[id] = std::make_shared<Ln>(built[n.left]);
+    } else {
+      built[id] = Binary::make(n.kind, built[n.left], built[n.right]);
+    }
+  }
+  return built[root];
+}
+
+std::string ExpressionArena::toString(Id root) const {
+  // Same traversal as serializer::writeTo: the stack holds the node and how
+  // far it has been written.
+  std::string out;
+  std::vector<std::pair<Id, int>> stack{{root, 0}};
+  while (!stack.empty()) {
+    Id id = stack.back().first;
+    int state = stack.back().second++;
+    const Node &n = nodes[id];
+    switch (n.kind) {
+    case Kind::Val:
+      out += std::to_string(n.value);
+      stack.pop_back();
+      break;
+    case Kind::Var:
+      out += names[n.value];
+      stack.pop_back();
+      break;
+    case Kind::Ln:
+      if (state == 0) {
+        out += "ln(";
+        stack.push_back({n.left, 0});
+      } else {
+        out += ')';
+        stack.pop_back();
+      }
+      break;
+    default:
+      if (state == 0) {
+        out += '(';
+        stack.push_back({n.left, 0});
+      } else if (state == 1) {
+        out += ' ';
+        out += signOf(n.kind);
+        out += ' ';
+        stack.push_back({n.right, 0});
+      } else {
+        out += ')';
+        stack.pop_back();
+      }
+    }
+  }
+  return out;
+}
+
+void ExpressionArena::clear() {
+  nodes.clear();
+  names.clear();
+  nameIndex.clear();
+  table.assign(kInitialTable, kEmpty);
+}
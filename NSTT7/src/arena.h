@@ -0,0 +1,70 @@
+#pragma once
+
+#include "expression.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Flat storage for large expression graphs.
+//
+// Nodes live in one contiguous array and refer to their children by index,
+// so building a graph costs no allocation per node and the whole graph is
+// released at once together with the arena. Nodes are hash-consed: building
+// an existing node again returns its id, and trivial rules (constant folding,
+// neutral and absorbing operands) are applied as nodes are built.
+class ExpressionArena {
+public:
+  using Kind = Expression::Kind;
+  using Id = uint32_t;
+
+  struct Node {
+    Kind kind;
+    // Constant for Val, index of the name for Var.
+    int value;
+    // Children of binary nodes; the argument of Ln is in `left`.
+    Id left, right;
+  };
+
+  ExpressionArena();
+
+  Id constant(int value);
+  Id variable(std::string_view name);
+  Id make(Kind kind, Id left, Id right);
+  Id ln(Id argument);
+
+  const Node &operator[](Id id) const { return nodes[id]; }
+  const std::string &getName(Id id) const { return names[nodes[id].value]; }
+  size_t size() const { return nodes.size(); }
+
+  Id diff(Id root, const std::string &variable);
+
+  Id import(const std::shared_ptr<Expression> &expression);
+  std::shared_ptr<Expression> toExpression(Id root) const;
+  std::string toString(Id root) const;
+
+  void clear();
+
+private:
+  static constexpr Id kEmpty = UINT32_MAX;
+
+  std::vector<Node> nodes;
+  std::vector<std::string> names;
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const {
+      return std::hash<std::string_view>()(name);
+    }
+  };
+  std::unordered_map<std::string, int, NameHash, std::equal_to<>> nameIndex;
+  // Open addressing table of node ids, at most half full.
+  std::vector<Id> table;
+
+  Id intern(const Node &node);
+  bool isConstant(Id id, int value) const {
+    return nodes[id].kind == Kind::Val && nodes[id].value == value;
+  }
+  // Derivative of one node, given those of its children in `memo`.
+  Id derivative(Id id, int variable, const std::vector<Id> &memo);
+};
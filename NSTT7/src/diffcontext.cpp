@@ -0,0 +1,55 @@
+#include "diffcontext.h"
+
+std::shared_ptr<Expression>
+DiffContext::derivative(const std::shared_ptr<Expression> &expression,
+                        const std::string &variable) {
+  std::shared_ptr<Expression> node = simplify(expression);
+  auto &derivatives = cache[variable];
+  if (auto it = derivatives.find(node.get()); it != derivatives.end()) {
+    return it->second;
+  }
+  // `node` is interned, so the cache key stays valid until clear().
+  std::shared_ptr<Expression> result = node->diff(variable, this);
+  cache[variable].emplace(node.get(), result);
+  return result;
+}
+
+std::shared_ptr<Expression>
+DiffContext::diffN(const std::shared_ptr<Expression> &expression,
+                   const std::string &variable, unsigned n) {
+  std::shared_ptr<Expression> result = simplify(expression);
+  for (unsigned i = 0; i < n; ++i) {
+    result = derivative(result, variable);
+  }
+  return result;
+}
+
+std::vector<std::vector<std::shared_ptr<Expression>>>
+DiffContext::jacobian(const std::vector<std::shared_ptr<Expression>> &functions,
+                      const std::vector<std::string> &variables) {
+  std::vector<std::vector<std::shared_ptr<Expression>>> result;
+  result.reserve(functions.size());
+  for (const std::shared_ptr<Expression> &function : functions) {
+    std::vector<std::shared_ptr<Expression>> &row = result.emplace_back();
+    row.reserve(variables.size());
+    for (const std::string &variable : variables) {
+      row.push_back(derivative(function, variable));
+    }
+  }
+  return result;
+}
+
+std::vector<std::vector<std::shared_ptr<Expression>>>
+DiffContext::hessian(const std::shared_ptr<Expression> &expression,
+                     const std::vector<std::string> &variables) {
+  size_t n = variables.size();
+  std::vector<std::vector<std::shared_ptr<Expression>>> result(
+      n, std::vector<std::shared_ptr<Expression>>(n));
+  for (size_t i = 0; i < n; ++i) {
+    std::shared_ptr<Expression> first = derivative(expression, variables[i]);
+    for (size_t j = i; j < n; ++j) {
+      result[i][j] = result[j][i] = derivative(first, variables[j]);
+    }
+  }
+  return result;
+}
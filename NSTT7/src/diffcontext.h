@@ -0,0 +1,53 @@
+#pragma once
+
+#include "simplifier.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Symbolic differentiation that remembers what it has already done.
+//
+// Every derivative is simplified and cached per (node, variable). Since the
+// simplifier interns its nodes, a subexpression shared by several functions,
+// by several partial derivatives or by successive orders of a derivative is
+// differentiated only once for each variable. Higher derivatives, Jacobians
+// and Hessians therefore cost roughly the number of distinct nodes involved
+// rather than the size of the expanded trees.
+class DiffContext : public Simplifier {
+  // Variable -> interned node -> its derivative.
+  std::unordered_map<std::string,
+                     std::unordered_map<const Expression *,
+                                        std::shared_ptr<Expression>>>
+      cache;
+
+public:
+  std::shared_ptr<Expression>
+  derivative(const std::shared_ptr<Expression> &expression,
+             const std::string &variable) override;
+
+  std::shared_ptr<Expression>
+  diff(const std::shared_ptr<Expression> &expression,
+       const std::string &variable) {
+    return derivative(expression, variable);
+  }
+
+  // n-th derivative; the 0-th is the simplified expression itself.
+  std::shared_ptr<Expression>
+  diffN(const std::shared_ptr<Expression> &expression,
+        const std::string &variable, unsigned n);
+
+  // result[i][j] is the derivative of functions[i] by variables[j].
+  std::vector<std::vector<std::shared_ptr<Expression>>>
+  jacobian(const std::vector<std::shared_ptr<Expression>> &functions,
+           const std::vector<std::string> &variables);
+
+  // Only the upper triangle is differentiated, the lower one is mirrored.
+  std::vector<std::vector<std::shared_ptr<Expression>>>
+  hessian(const std::shared_ptr<Expression> &expression,
+          const std::vector<std::string> &variables);
+
+  void clear() {
+    cache.clear();
+    Simplifier::clear();
+  }
+};
@@ -1,55 +1,192 @@
 #include "expression.h"
+#include "serializer.h"
+#include "simplifier.h"
 #include <stdexcept>
+#include <unordered_set>
+#include <vector>
 
-std::shared_ptr<Expression> Var::diff(const std::string &variable) const {
+namespace {
+
+template <typename Node>
+std::shared_ptr<Expression> combine(Simplifier *simplifier,
+                                    std::shared_ptr<Expression> l,
+                                    std::shared_ptr<Expression> r) {
+  std::shared_ptr<Expression> node = std::make_shared<Node>(l, r);
+  return simplifier ? simplifier->simplifyNode(node) : node;
+}
+
+std::shared_ptr<Expression> constant(Simplifier *simplifier, int value) {
+  return simplifier ? simplifier->constant(value)
+                    : std::make_shared<Val>(value);
+}
+
+std::shared_ptr<Expression> logarithm(Simplifier *simplifier,
+                                      std::shared_ptr<Expression> argument) {
+  std::shared_ptr<Expression> node = std::make_shared<Ln>(argument);
+  return simplifier ? simplifier->simplifyNode(node) : node;
+}
+
+// Children are differentiated through the simplifier, which lets a
+// DiffContext answer from its cache.
+std::shared_ptr<Expression> derivative(Simplifier *simplifier,
+                                       const std::shared_ptr<Expression> &e,
+                                       const std::string &variable) {
+  return simplifier ? simplifier->derivative(e, variable)
+                    : e->diff(variable);
+}
+
+// Searches with its own stack so that deep trees cannot overflow the call
+// stack, and visits shared subtrees once.
+bool dependsOn(const Expression &e, const std::string &variable) {
+  std::unordered_set<const Expression *> seen;
+  std::vector<const Expression *> stack{&e};
+  while (!stack.empty()) {
+    const Expression *node = stack.back();
+    stack.pop_back();
+    switch (node->getKind()) {
+    case Expression::Kind::Var:
+      if (static_cast<const Var &>(*node).getName() == variable) {
+        return true;
+      }
+      break;
+    case Expression::Kind::Val:
+      break;
+    case Expression::Kind::Ln:
+      if (seen.insert(node).second) {
+        stack.push_back(static_cast<const Ln &>(*node).getArgument().get());
+      }
+      break;
+    default:
+      if (seen.insert(node).second) {
+        const Binary &b = static_cast<const Binary &>(*node);
+        stack.push_back(b.getRight().get());
+        stack.push_back(b.getLeft().get());
+      }
+    }
+  }
+  return false;
+}
+
+// A simplified derivative is the constant 0 exactly when `e` does not depend
+// on the variable; without a simplifier the tree has to be searched.
+bool isConstantIn(const Expression &e, const std::shared_ptr<Expression> &de,
+                  const std::string &variable, Simplifier *simplifier) {
+  if (simplifier) {
+    return de->getKind() == Expression::Kind::Val &&
+           static_cast<const Val &>(*de).getValue() == 0;
+  }
+  return !dependsOn(e, variable);
+}
+
+} // namespace
+
+std::shared_ptr<Expression> Binary::make(Kind kind,
+                                         std::shared_ptr<Expression> l,
+                                         std::shared_ptr<Expression> r) {
+  switch (kind) {
+  case Kind::Add:
+    return std::make_shared<Add>(l, r);
+  case Kind::Sub:
+    return std::make_shared<Sub>(l, r);
+  case Kind::Mult:
+    return std::make_shared<Mult>(l, r);
+  case Kind::Div:
+    return std::make_shared<Div>(l, r);
+  case Kind::Exponent:
+    return std::make_shared<Exponent>(l, r);
+  default:
+    throw std::invalid_argument("Not a binary operation");
+  }
+}
+
+std::stringstream Expression::toStringStream() const {
+  std::stringstream ss;
+  ss << *this;
+  return ss;
+}
+
+std::shared_ptr<Expression> Var::diff(const std::string &variable,
+                                      Simplifier *simplifier) const {
   if (variable == name) {
-    return std::make_shared<Val>(1); 
+    return constant(simplifier, 1);
   } else {
-    return std::make_shared<Val>(0);
+    return constant(simplifier, 0);
   }
 }
 
-std::shared_ptr<Expression> Exponent::diff(const std::string &variable) const {
-  if (std::shared_ptr<Var> v = std::dynamic_pointer_cast<Var>(right);
-      v && v->getName() == variable) {
-    throw std::runtime_error("Chain rule not implemented yet");
-  } else if (std::shared_ptr<Var> v = std::dynamic_pointer_cast<Var>(left);
-             v && v->getName() == variable) {
-    std::shared_ptr<Sub> n_minus_one =
-        std::make_shared<Sub>(right, std::make_shared<Val>(1));
-    return std::make_shared<Mult>(
-        std::make_shared<Mult>(right,
-                               std::make_shared<Exponent>(left, n_minus_one)),
-        left->diff(variable));
-  } else {
-    return std::make_shared<Val>(0);
+std::shared_ptr<Expression> Exponent::diff(const std::string &variable,
+                                           Simplifier *simplifier) const {
+  std::shared_ptr<Expression> dl = derivative(simplifier, left, variable);
+  std::shared_ptr<Expression> dr = derivative(simplifier, right, variable);
+  bool constantBase = isConstantIn(*left, dl, variable, simplifier);
+  bool constantExponent = isConstantIn(*right, dr, variable, simplifier);
+  if (constantBase && constantExponent) {
+    return constant(simplifier, 0);
+  }
+  if (constantExponent) {
+    // (f ^ n)' = n * f ^ (n - 1) * f'
+    std::shared_ptr<Expression> n_minus_one =
+        combine<Sub>(simplifier, right, constant(simplifier, 1));
+    return combine<Mult>(
+        simplifier,
+        combine<Mult>(simplifier, right,
+                      combine<Exponent>(simplifier, left, n_minus_one)),
+        dl);
+  }
+  std::shared_ptr<Expression> power =
+      combine<Exponent>(simplifier, left, right);
+  std::shared_ptr<Expression> ln = logarithm(simplifier, left);
+  if (constantBase) {
+    // (c ^ g)' = c ^ g * (ln(c) * g')
+    return combine<Mult>(simplifier, power,
+                         combine<Mult>(simplifier, ln, dr));
   }
+  // (f ^ g)' = f ^ g * (g' * ln(f) + (g * f') / f)
+  return combine<Mult>(
+      simplifier, power,
+      combine<Add>(simplifier, combine<Mult>(simplifier, dr, ln),
+                   combine<Div>(simplifier,
+                                combine<Mult>(simplifier, right, dl), left)));
 }
 
-std::shared_ptr<Expression> Div::diff(const std::string &variable) const {
-  return std::make_shared<Div>(
-      std::make_shared<Sub>(
-          std::make_shared<Mult>(left->diff(variable), right),
-          std::make_shared<Mult>(left, right->diff(variable))),
-      std::make_shared<Mult>(right, right));
+std::shared_ptr<Expression> Ln::diff(const std::string &variable,
+                                     Simplifier *simplifier) const {
+  return combine<Div>(simplifier, derivative(simplifier, argument, variable),
+                      argument);
 }
 
-std::shared_ptr<Expression> Mult::diff(const std::string &variable) const {
-  return std::make_shared<Add>(
-      std::make_shared<Mult>(left->diff(variable), right),
-      std::make_shared<Mult>(left, right->diff(variable)));
+std::shared_ptr<Expression> Div::diff(const std::string &variable,
+                                      Simplifier *simplifier) const {
+  std::shared_ptr<Expression> dl = derivative(simplifier, left, variable);
+  std::shared_ptr<Expression> dr = derivative(simplifier, right, variable);
+  return combine<Div>(
+      simplifier,
+      combine<Sub>(simplifier, combine<Mult>(simplifier, dl, right),
+                   combine<Mult>(simplifier, left, dr)),
+      combine<Mult>(simplifier, right, right));
 }
 
-std::shared_ptr<Expression> Sub::diff(const std::string &variable) const {
-  return std::make_shared<Sub>(
-      std::make_shared<Sub>(left->diff(variable), right),
-      right->diff(variable));
+std::shared_ptr<Expression> Mult::diff(const std::string &variable,
+                                       Simplifier *simplifier) const {
+  std::shared_ptr<Expression> dl = derivative(simplifier, left, variable);
+  std::shared_ptr<Expression> dr = derivative(simplifier, right, variable);
+  return combine<Add>(simplifier, combine<Mult>(simplifier, dl, right),
+                      combine<Mult>(simplifier, left, dr));
 }
 
-std::shared_ptr<Expression> Add::diff(const std::string &variable) const {
-  return std::make_shared<Add>(left->diff(variable), right->diff(variable));
+std::shared_ptr<Expression> Sub::diff(const std::string &variable,
+                                      Simplifier *simplifier) const {
+  return combine<Sub>(simplifier, derivative(simplifier, left, variable),
+                      derivative(simplifier, right, variable));
 }
 
-std::shared_ptr<Expression> Val::diff(const std::string &variable) const {
-  return std::make_shared<Val>(0);
-}
\ No newline at end of file
+std::shared_ptr<Expression> Add::diff(const std::string &variable,
+                                      Simplifier *simplifier) const {
+  return combine<Add>(simplifier, derivative(simplifier, left, variable),
+                      derivative(simplifier, right, variable));
+}
+
+std::shared_ptr<Expression> Val::diff(const std::string &variable,
+                                      Simplifier *simplifier) const {
+  return constant(simplifier, 0);
+}
@@ -1,12 +1,34 @@
+#pragma once
+
+#include <cstdint>
 #include <memory>
 #include <sstream>
 
+class Simplifier;
+
 class Expression {
+public:
+  // Concrete node type. Kept in the node itself so that type checks are a
+  // plain compare instead of a dynamic_cast.
+  enum class Kind : uint8_t { Var, Val, Add, Sub, Mult, Div, Exponent, Ln };
+
+private:
+  const Kind kind;
+
+protected:
+  Expression(Kind kind) : kind(kind) {}
 
 public:
+  Kind getKind() const { return kind; }
+  bool isBinary() const { return kind >= Kind::Add && kind <= Kind::Exponent; }
+
+  // When a simplifier is given, every node of the derivative is simplified
+  // as soon as it is built, so the result never grows `x * 0` style noise.
   virtual std::shared_ptr<Expression>
-  diff(const std::string &variable) const = 0;
-  virtual std::stringstream toStringStream() const = 0;
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const = 0;
+  // Infix form, see serializer.h for writing into other sinks.
+  std::stringstream toStringStream() const;
 };
 
 class Binary : public Expression {
@@ -16,45 +38,54 @@ protected:
 public:
   virtual char getSign() const = 0;
 
-  Binary(std::shared_ptr<Expression> l, std::shared_ptr<Expression> r)
-      : left(l), right(r) {}
-  std::stringstream toStringStream() const {
-    std::stringstream ss;
-    ss << "(" << left->toStringStream().str() << " " << getSign() << " "
-       << right->toStringStream().str() << ")";
-    return ss;
-  }
+  Binary(Kind kind, std::shared_ptr<Expression> l,
+         std::shared_ptr<Expression> r)
+      : Expression(kind), left(l), right(r) {}
+  std::shared_ptr<Expression> getLeft() const { return left; }
+  std::shared_ptr<Expression> getRight() const { return right; }
+
+  static std::shared_ptr<Expression> make(Kind kind,
+                                          std::shared_ptr<Expression> l,
+                                          std::shared_ptr<Expression> r);
 };
 
 class Add : public Binary {
 public:
   Add(std::shared_ptr<Expression> l, std::shared_ptr<Expression> r)
-      : Binary(l, r) {}
-  std::shared_ptr<Expression> diff(const std::string &variable) const override;
+      : Binary(Kind::Add, l, r) {}
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
   char getSign() const override { return '+'; }
 };
 
 class Sub : public Binary {
 public:
   Sub(std::shared_ptr<Expression> l, std::shared_ptr<Expression> r)
-      : Binary(l, r) {}
-  std::shared_ptr<Expression> diff(const std::string &variable) const override;
+      : Binary(Kind::Sub, l, r) {}
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
   char getSign() const override { return '-'; }
 };
 
 class Mult : public Binary {
 public:
   Mult(std::shared_ptr<Expression> l, std::shared_ptr<Expression> r)
-      : Binary(l, r) {}
-  std::shared_ptr<Expression> diff(const std::string &variable) const override;
+      : Binary(Kind::Mult, l, r) {}
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
   char getSign() const override { return '*'; }
 };
 
 class Div : public Binary {
 public:
   Div(std::shared_ptr<Expression> l, std::shared_ptr<Expression> r)
-      : Binary(l, r) {}
-  std::shared_ptr<Expression> diff(const std::string &variable) const override;
+      : Binary(Kind::Div, l, r) {}
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
   char getSign() const override { return '/'; }
 };
 
@@ -62,24 +93,38 @@ class Exponent : public Binary {
 public:
   Exponent(std::shared_ptr<Expression> base,
            std::shared_ptr<Expression> exponent)
-      : Binary(base, exponent) {}
-  std::shared_ptr<Expression> diff(const std::string &variable) const override;
+      : Binary(Kind::Exponent, base, exponent) {}
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
   char getSign() const override { return '^'; }
 };
 
+// Natural logarithm, needed for derivatives of powers with a variable
+// exponent.
+class Ln : public Expression {
+private:
+  std::shared_ptr<Expression> argument;
+
+public:
+  Ln(std::shared_ptr<Expression> argument)
+      : Expression(Kind::Ln), argument(argument) {}
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
+  std::shared_ptr<Expression> getArgument() const { return argument; }
+};
+
 class Var : public Expression {
 private:
   std::string name;
 
 public:
-  Var(const std::string &n) : name(n) {}
-  std::shared_ptr<Expression> diff(const std::string &variable) const override;
-  std::string getName() const { return name; }
-  std::stringstream toStringStream() const override {
-    std::stringstream ss;
-    ss << name;
-    return ss;
-  }
+  Var(const std::string &n) : Expression(Kind::Var), name(n) {}
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
+  const std::string &getName() const { return name; }
 };
 
 class Val : public Expression {
@@ -87,13 +132,10 @@ private:
   int value;
 
 public:
-  Val(int val) : value(val) {}
+  Val(int val) : Expression(Kind::Val), value(val) {}
 
-  std::shared_ptr<Expression> diff(const std::string &variable) const override;
+  std::shared_ptr<Expression>
+  diff(const std::string &variable,
+       Simplifier *simplifier = nullptr) const override;
   int getValue() const { return value; }
-  std::stringstream toStringStream() const override {
-    std::stringstream ss;
-    ss << value;
-    return ss;
-  }
 };
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "gradient.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Gradient::Gradient(const std::shared_ptr<Expression> &expression,
+                   const std::vector<std::string> &variables)
+    : tape(expression, variables, false) {}
+
+double Gradient::evaluate(const std::vector<double> &point,
+                          std::vector<double> &gradient) const {
+  if (point.size() != tape.getVariables().size()) {
+    throw std::invalid_argument("Wrong number of variables");
+  }
+  const std::vector<Tape::Instruction> &program = tape.getInstructions();
+  std::vector<double> values(program.size());
+  for (const Tape::Instruction &ins : program) {
+    switch (ins.op) {
+    case Tape::Op::Input:
+      values[ins.dst] = point[ins.a];
+      break;
+    case Tape::Op::Const:
+      values[ins.dst] = ins.value;
+      break;
+    case Tape::Op::Add:
+      values[ins.dst] = values[ins.a] + values[ins.b];
+      break;
+    case Tape::Op::Sub:
+      values[ins.dst] = values[ins.a] - values[ins.b];
+      break;
+    case Tape::Op::Mult:
+      values[ins.dst] = values[ins.a] * values[ins.b];
+      break;
+    case Tape::Op::Div:
+      values[ins.dst] = values[ins.a] / values[ins.b];
+      break;
+    case Tape::Op::Pow:
+      values[ins.dst] = std::pow(values[ins.a], values[ins.b]);
+      break;
+    case Tape::Op::Log:
+      values[ins.dst] = std::log(values[ins.a]);
+      break;
+    }
+  }
+
+  std::vector<double> adjoints(program.size(), 0.0);
+  adjoints[tape.getOutputs()[0]] = 1;
+  gradient.assign(tape.getVariables().size(), 0.0);
+  for (size_t i = program.size(); i-- > 0;) {
+    const Tape::Instruction &ins = program[i];
+    double g = adjoints[i];
+    switch (ins.op) {
+    case Tape::Op::Input:
+      gradient[ins.a] = g;
+      break;
+    case Tape::Op::Const:
+      break;
+    case Tape::Op::Add:
+      adjoints[ins.a] += g;
+      adjoints[ins.b] += g;
+      break;
+    case Tape::Op::Sub:
+      adjoints[ins.a] += g;
+      adjoints[ins.b] -= g;
+      break;
+    case Tape::Op::Mult:
+      adjoints[ins.a] += g * values[ins.b];
+      adjoints[ins.b] += g * values[ins.a];
+      break;
+    case Tape::Op::Div:
+      adjoints[ins.a] += g / values[ins.b];
+      adjoints[ins.b] -= g * values[i] / values[ins.b];
+      break;
+    case Tape::Op::Pow: {
+      double a = values[ins.a], b = values[ins.b];
+      adjoints[ins.a] += g * b * std::pow(a, b - 1);
+      if (program[ins.b].op != Tape::Op::Const) {
+        adjoints[ins.b] += g * values[i] * std::log(a);
+      }
+      break;
+    }
+    case Tape::Op::Log:
+      adjoints[ins.a] += g / values[ins.a];
+      break;
+    }
+  }
+  return values[tape.getOutputs()[0]];
+}
+
+void Gradient::evaluate(const std::vector<const double *> &columns,
+                        size_t count, double *values,
+                        const std::vector<double *> &gradients) const {
+  if (columns.size() != tape.getVariables().size()) {
+    throw std::invalid_argument("Wrong number of variables");
+  }
+  if (gradients.size() != tape.getVariables().size()) {
+    throw std::invalid_argument("Wrong number of gradients");
+  }
+  size_t registers = tape.getRegisterCount() * Tape::kBlock;
+  std::vector<double> forward(registers), backward(registers);
+  std::vector<double> scratch(values ? 0 : count);
+  double *result = values ? values : scratch.data();
+  for (size_t offset = 0; offset < count; offset += Tape::kBlock) {
+    evaluateBlock(columns, offset, std::min(Tape::kBlock, count - offset),
+                  forward.data(), backward.data(), result, gradients);
+  }
+}
+
+void Gradient::evaluateBlock(const std::vector<const double *> &columns,
+                             size_t offset, size_t count, double *values,
+                             double *adjoints, double *result,
+                             const std::vector<double *> &gradients) const {
+  constexpr size_t B = Tape::kBlock;
+  const std::vector<Tape::Instruction> &program = tape.getInstructions();
+  tape.evaluateBlock(columns, offset, count, values, {result});
+
+  std::fill(adjoints, adjoints + program.size() * B, 0.0);
+  std::fill(adjoints + tape.getOutputs()[0] * B,
+            adjoints + (tape.getOutputs()[0] + 1) * B, 1.0);
+  for (double *gradient : gradients) {
+    std::fill(gradient + offset, gradient + offset + count, 0.0);
+  }
+  for (size_t i = program.size(); i-- > 0;) {
+    const Tape::Instruction &ins = program[i];
+    const double *g = adjoints + i * B;
+    // The operands of Input are a column, not a slot, and Const has none.
+    if (ins.op == Tape::Op::Input) {
+      std::copy(g, g + count, gradients[ins.a] + offset);
+      continue;
+    }
+    if (ins.op == Tape::Op::Const) {
+      continue;
+    }
+    const double *v = values + i * B;
+    const double *a = values + ins.a * B;
+    const double *b = values + ins.b * B;
+    double *ga = adjoints + ins.a * B;
+    double *gb = adjoints + ins.b * B;
+    switch (ins.op) {
+    case Tape::Op::Input:
+    case Tape::Op::Const:
+      break;
+    case Tape::Op::Add:
+      for (size_t k = 0; k < count; ++k) {
+        ga[k] += g[k];
+        gb[k] += g[k];
+      }
+      break;
+    case Tape::Op::Sub:
+      for (size_t k = 0; k < count; ++k) {
+        ga[k] += g[k];
+        gb[k] -= g[k];
+      }
+      break;
+    case Tape::Op::Mult:
+      for (size_t k = 0; k < count; ++k) {
+        ga[k] += g[k] * b[k];
+        gb[k] += g[k] * a[k];
+      }
+      break;
+    case Tape::Op::Div:
+      for (size_t k = 0; k < count; ++k) {
+        ga[k] += g[k] / b[k];
+        gb[k] -= g[k] * v[k] / b[k];
+      }
+      break;
+    case Tape::Op::Pow:
+      for (size_t k = 0; k < count; ++k) {
+        ga[k] += g[k] * b[k] * std::pow(a[k], b[k] - 1);
+      }
+      if (program[ins.b].op != Tape::Op::Const) {
+        for (size_t k = 0; k < count; ++k) {
+          gb[k] += g[k] * v[k] * std::log(a[k]);
+        }
+      }
+      break;
+    case Tape::Op::Log:
+      for (size_t k = 0; k < count; ++k) {
+        ga[k] += g[k] / a[k];
+      }
+      break;
+    }
+  }
+}
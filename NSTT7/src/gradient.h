@@ -0,0 +1,34 @@
+#pragma once
+
+#include "tape.h"
+
+// Reverse-mode automatic differentiation of a single expression.
+//
+// The expression is compiled once into an SSA tape. One forward sweep records
+// every intermediate value and one backward sweep accumulates the adjoints,
+// which yields all partial derivatives at once instead of one symbolic
+// derivative per variable.
+class Gradient {
+  Tape tape;
+
+  void evaluateBlock(const std::vector<const double *> &columns,
+                     size_t offset, size_t count, double *values,
+                     double *adjoints, double *result,
+                     const std::vector<double *> &gradients) const;
+
+public:
+  Gradient(const std::shared_ptr<Expression> &expression,
+           const std::vector<std::string> &variables);
+
+  const Tape &getTape() const { return tape; }
+
+  // Returns the value at `point`; gradient[i] receives the partial
+  // derivative with respect to variables[i].
+  double evaluate(const std::vector<double> &point,
+                  std::vector<double> &gradient) const;
+
+  // Batched form over columns of inputs, see Tape::evaluate. `values` may be
+  // null when only the gradients are needed.
+  void evaluate(const std::vector<const double *> &columns, size_t count,
+                double *values, const std::vector<double *> &gradients) const;
+};
@@ -0,0 +1,293 @@
+#include "parser.h"
+#include <charconv>
+#include <climits>
+
+namespace {
+
+using Kind = Expression::Kind;
+
+// Deeper nesting is rejected instead of risking the call stack.
+constexpr int kMaxDepth = 4096;
+
+class TreeBuilder {
+  Parser &parser;
+
+public:
+  using Node = std::shared_ptr<Expression>;
+
+  TreeBuilder(Parser &parser) : parser(parser) {}
+
+  Node constant(int value) { return parser.constant(value); }
+  Node variable(std::string_view name) { return parser.variable(name); }
+  Node make(Kind kind, Node l, Node r) {
+    return Binary::make(kind, std::move(l), std::move(r));
+  }
+  Node ln(Node argument) { return std::make_shared<Ln>(std::move(argument)); }
+  bool isConstant(const Node &node, int &value) const {
+    if (node->getKind() != Kind::Val) {
+      return false;
+    }
+    value = static_cast<const Val &>(*node).getValue();
+    return true;
+  }
+};
+
+class ArenaBuilder {
+  ExpressionArena &arena;
+
+public:
+  using Node = ExpressionArena::Id;
+
+  ArenaBuilder(ExpressionArena &arena) : arena(arena) {}
+
+  Node constant(int value) { return arena.constant(value); }
+  Node variable(std::string_view name) { return arena.variable(name); }
+  Node make(Kind kind, Node l, Node r) { return arena.make(kind, l, r); }
+  Node ln(Node argument) { return arena.ln(argument); }
+  bool isConstant(Node node, int &value) const {
+    if (arena[node].kind != Kind::Val) {
+      return false;
+    }
+    value = arena[node].value;
+    return true;
+  }
+};
+
+bool isIdentifierStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isIdentifier(char c) {
+  return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+template <typename Builder> class ParserImpl {
+  using Node = typename Builder::Node;
+
+  Builder &builder;
+  ParseError &error;
+  const char *begin, *p, *end;
+  int depth = 0;
+
+  Node fail(const char *at, const char *message) {
+    if (!error) {
+      error.position = at - begin;
+      error.message = message;
+    }
+    return Node{};
+  }
+
+  void skipSpaces() {
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+      ++p;
+    }
+  }
+
+  // Each rule returns with `p` on the next non-space character.
+  Node sum() {
+    Node node = product();
+    while (!error && p != end && (*p == '+' || *p == '-')) {
+      Kind kind = *p++ == '+' ? Kind::Add : Kind::Sub;
+      Node right = product();
+      if (error) {
+        return node;
+      }
+      node = builder.make(kind, std::move(node), std::move(right));
+    }
+    return node;
+  }
+
+  Node product() {
+    Node node = unary();
+    while (!error && p != end && (*p == '*' || *p == '/')) {
+      Kind kind = *p++ == '*' ? Kind::Mult : Kind::Div;
+      Node right = unary();
+      if (error) {
+        return node;
+      }
+      node = builder.make(kind, std::move(node), std::move(right));
+    }
+    return node;
+  }
+
+  Node unary() {
+    skipSpaces();
+    if (p == end || *p != '-') {
+      return power();
+    }
+    const char *minus = p++;
+    if (Node node; negativeLimit(node)) {
+      return node;
+    }
+    if (++depth > kMaxDepth) {
+      return fail(minus, "Expression is nested too deeply");
+    }
+    Node operand = unary();
+    --depth;
+    int value;
+    if (error) {
+      return operand;
+    }
+    if (builder.isConstant(operand, value) && value != INT_MIN) {
+      return builder.constant(-value);
+    }
+    return builder.make(Kind::Mult, builder.constant(-1), std::move(operand));
+  }
+
+  // -2147483648 is in range only once it is negated, so its literal is
+  // read here rather than by primary. Other literals are negated after
+  // they have been parsed.
+  bool negativeLimit(Node &node) {
+    skipSpaces();
+    long long magnitude;
+    auto [next, ec] = std::from_chars(p, end, magnitude);
+    if (ec != std::errc() || magnitude != -static_cast<long long>(INT_MIN)) {
+      return false;
+    }
+    const char *literal = p;
+    p = next;
+    skipSpaces();
+    // As a base it is not negated: -2147483648^2 is -(2147483648^2).
+    if (p != end && *p == '^') {
+      p = literal;
+      return false;
+    }
+    node = builder.constant(INT_MIN);
+    return true;
+  }
+
+  Node power() {
+    Node base = primary();
+    skipSpaces();
+    if (error || p == end || *p != '^') {
+      return base;
+    }
+    const char *caret = p++;
+    if (++depth > kMaxDepth) {
+      return fail(caret, "Expression is nested too deeply");
+    }
+    Node exponent = unary();
+    --depth;
+    if (error) {
+      return base;
+    }
+    return builder.make(Kind::Exponent, std::move(base), std::move(exponent));
+  }
+
+  Node parenthesized() {
+    const char *open = p++;
+    if (++depth > kMaxDepth) {
+      return fail(open, "Expression is nested too deeply");
+    }
+    Node node = sum();
+    --depth;
+    if (error) {
+      return node;
+    }
+    if (p == end || *p != ')') {
+      return fail(p, "Expected ')'");
+    }
+    ++p;
+    skipSpaces();
+    return node;
+  }
+
+  Node primary() {
+    skipSpaces();
+    if (p == end) {
+      return fail(p, "Unexpected end of input");
+    }
+    const char *start = p;
+    if (*p >= '0' && *p <= '9') {
+      int value;
+      auto [next, ec] = std::from_chars(p, end, value);
+      if (ec != std::errc()) {
+        return fail(start, "Integer literal out of range");
+      }
+      p = next;
+      skipSpaces();
+      return builder.constant(value);
+    }
+    if (isIdentifierStart(*p)) {
+      while (p != end && isIdentifier(*p)) {
+        ++p;
+      }
+      std::string_view name(start, p - start);
+      skipSpaces();
+      if (name == "ln" && p != end && *p == '(') {
+        Node argument = parenthesized();
+        return error ? argument : builder.ln(std::move(argument));
+      }
+      return builder.variable(name);
+    }
+    if (*p == '(') {
+      return parenthesized();
+    }
+    return fail(start, "Expected a number, a variable or '('");
+  }
+
+public:
+  ParserImpl(Builder &builder, ParseError &error, std::string_view text)
+      : builder(builder), error(error), begin(text.data()), p(text.data()),
+        end(text.data() + text.size()) {}
+
+  Node parse() {
+    error = ParseError{};
+    Node node = sum();
+    if (!error && p != end) {
+      return fail(p, "Unexpected character");
+    }
+    return error ? Node{} : node;
+  }
+};
+
+} // namespace
+
+std::shared_ptr<Expression> Parser::variable(std::string_view name) {
+  auto it = variables.find(name);
+  if (it == variables.end()) {
+    it = variables.emplace(name, std::make_shared<Var>(std::string(name)))
+             .first;
+  }
+  return it->second;
+}
+
+std::shared_ptr<Expression> Parser::constant(int value) {
+  std::shared_ptr<Expression> &node = constants[value];
+  if (!node) {
+    node = std::make_shared<Val>(value);
+  }
+  return node;
+}
+
+std::shared_ptr<Expression> Parser::parse(std::string_view text,
+                                          ParseError &error) {
+  TreeBuilder builder(*this);
+  return ParserImpl<TreeBuilder>(builder, error, text).parse();
+}
+
+ExpressionArena::Id Parser::parse(std::string_view text,
+                                  ExpressionArena &arena, ParseError &error) {
+  ArenaBuilder builder(arena);
+  return ParserImpl<ArenaBuilder>(builder, error, text).parse();
+}
+
+std::vector<std::shared_ptr<Expression>>
+Parser::parseLines(std::string_view text, std::vector<ParseError> &errors) {
+  std::vector<std::shared_ptr<Expression>> result;
+  size_t offset = 0;
+  while (offset < text.size()) {
+    size_t newline = text.find('\n', offset);
+    if (newline == std::string_view::npos) {
+      newline = text.size();
+    }
+    ParseError error;
+    result.push_back(parse(text.substr(offset, newline - offset), error));
+    if (error) {
+      error.position += offset;
+      errors.push_back(error);
+    }
+    offset = newline + 1;
+  }
+  return result;
+}
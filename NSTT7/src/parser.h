@@ -0,0 +1,67 @@
+#pragma once
+
+#include "arena.h"
+#include "expression.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Where and why parsing stopped. `message` is null when parsing succeeded.
+struct ParseError {
+  size_t position = 0;
+  const char *message = nullptr;
+
+  explicit operator bool() const { return message != nullptr; }
+};
+
+// Single pass recursive descent parser for infix formulas:
+//
+//   sum     := product (('+' | '-') product)*
+//   product := unary (('*' | '/') unary)*
+//   unary   := '-' unary | power
+//   power   := primary ('^' unary)?
+//   primary := integer | 'ln' '(' sum ')' | identifier | '(' sum ')'
+//
+// `^` is right associative and binds tighter than unary minus, so `-x^2` is
+// `-(x^2)`. A minus in front of a literal gives a negative Val, otherwise it
+// becomes a product with -1. Errors are reported through ParseError rather
+// than exceptions.
+//
+// Variables and constants are interned in the parser, so a batch of formulas
+// parsed by one Parser shares its leaves.
+class Parser {
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const {
+      return std::hash<std::string_view>()(name);
+    }
+  };
+
+  std::unordered_map<std::string, std::shared_ptr<Expression>, NameHash,
+                     std::equal_to<>>
+      variables;
+  std::unordered_map<int, std::shared_ptr<Expression>> constants;
+
+public:
+  // Interned leaves, shared by every formula parsed so far.
+  std::shared_ptr<Expression> variable(std::string_view name);
+  std::shared_ptr<Expression> constant(int value);
+
+  // Returns null and sets `error` when the text is not a valid formula.
+  std::shared_ptr<Expression> parse(std::string_view text, ParseError &error);
+
+  // Parses straight into an arena; the result is meaningless on error.
+  ExpressionArena::Id parse(std::string_view text, ExpressionArena &arena,
+                            ParseError &error);
+
+  // One formula per line. Failed lines produce null and their errors, with
+  // positions relative to the start of `text`, are appended to `errors`.
+  std::vector<std::shared_ptr<Expression>>
+  parseLines(std::string_view text, std::vector<ParseError> &errors);
+
+  void clear() {
+    variables.clear();
+    constants.clear();
+  }
+};
@@ -0,0 +1,101 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <stdexcept>
+
+ParallelEvaluator::ParallelEvaluator(
+    const std::vector<std::shared_ptr<Expression>> &outputs,
+    const std::vector<std::string> &variables, ThreadPool &pool, size_t grain)
+    : ssa(outputs, variables, false), compact(outputs, variables),
+      pool(pool), grain(grain) {
+  const std::vector<Tape::Instruction> &program = ssa.getInstructions();
+  std::vector<uint32_t> level(program.size(), 0);
+  uint32_t depth = 0;
+  for (const Tape::Instruction &ins : program) {
+    if (ins.op != Tape::Op::Input && ins.op != Tape::Op::Const) {
+      level[ins.dst] = std::max(level[ins.a], level[ins.b]) + 1;
+      depth = std::max(depth, level[ins.dst]);
+    }
+  }
+  // Counting sort by level keeps program order within a level.
+  levelStart.assign(depth + 2, 0);
+  for (uint32_t l : level) {
+    ++levelStart[l + 1];
+  }
+  for (size_t l = 1; l < levelStart.size(); ++l) {
+    levelStart[l] += levelStart[l - 1];
+  }
+  order.resize(program.size());
+  std::vector<uint32_t> fill(levelStart.begin(), levelStart.end() - 1);
+  for (uint32_t i = 0; i < program.size(); ++i) {
+    order[fill[level[i]]++] = i;
+  }
+}
+
+std::vector<double>
+ParallelEvaluator::evaluate(const std::vector<double> &point) const {
+  if (point.size() != ssa.getVariables().size()) {
+    throw std::invalid_argument("Wrong number of variables");
+  }
+  const std::vector<Tape::Instruction> &program = ssa.getInstructions();
+  std::vector<double> values(program.size());
+  auto run = [&](const uint32_t *begin, const uint32_t *end) {
+    for (const uint32_t *it = begin; it != end; ++it) {
+      const Tape::Instruction &ins = program[*it];
+      switch (ins.op) {
+      case Tape::Op::Input:
+        values[ins.dst] = point[ins.a];
+        break;
+      case Tape::Op::Const:
+        values[ins.dst] = ins.value;
+        break;
+      default:
+        values[ins.dst] =
+            Tape::compute(ins.op, values[ins.a], values[ins.b]);
+      }
+    }
+  };
+  // Consecutive narrow levels are run back to back without a barrier.
+  size_t serialFrom = 0;
+  for (size_t l = 0; l + 1 < levelStart.size(); ++l) {
+    const uint32_t *begin = order.data() + levelStart[l];
+    size_t width = levelStart[l + 1] - levelStart[l];
+    if (width < 2 * grain) {
+      continue;
+    }
+    run(order.data() + serialFrom, begin);
+    pool.parallelFor(width, grain, [&](size_t from, size_t to) {
+      run(begin + from, begin + to);
+    });
+    serialFrom = levelStart[l + 1];
+  }
+  run(order.data() + serialFrom, order.data() + order.size());
+
+  std::vector<double> result;
+  for (uint32_t output : ssa.getOutputs()) {
+    result.push_back(values[output]);
+  }
+  return result;
+}
+
+void ParallelEvaluator::evaluate(const std::vector<const double *> &columns,
+                                 size_t count,
+                                 const std::vector<double *> &results) const {
+  if (columns.size() != compact.getVariables().size()) {
+    throw std::invalid_argument("Wrong number of variables");
+  }
+  if (results.size() != compact.getOutputs().size()) {
+    throw std::invalid_argument("Wrong number of outputs");
+  }
+  constexpr size_t B = Tape::kBlock;
+  size_t blocks = (count + B - 1) / B;
+  size_t work = std::max<size_t>(compact.getInstructions().size() * B, 1);
+  size_t blockGrain = std::max<size_t>((grain + work - 1) / work, 1);
+  pool.parallelFor(blocks, blockGrain, [&](size_t from, size_t to) {
+    std::vector<double> registers(compact.getRegisterCount() * B);
+    for (size_t block = from; block < to; ++block) {
+      size_t offset = block * B;
+      compact.evaluateBlock(columns, offset, std::min(B, count - offset),
+                            registers.data(), results);
+    }
+  });
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "tape.h"
+#include "threadpool.h"
+
+// Evaluates large expression DAGs on all cores of a ThreadPool.
+//
+// A single point is evaluated level by level: an instruction's level is one
+// more than the deepest of its operands, so all instructions of a level are
+// independent and can be split among threads, with one barrier per level.
+// Levels with fewer than `grain` instructions run on the calling thread,
+// which keeps narrow or small graphs free of synchronisation.
+//
+// A batch of points is split into runs of whole blocks instead, each thread
+// streaming its runs through the register-allocated tape.
+class ParallelEvaluator {
+  // SSA form for level scheduling, register-allocated form for batches.
+  Tape ssa, compact;
+  // Instructions of level l are order[levelStart[l], levelStart[l + 1]).
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> levelStart;
+  ThreadPool &pool;
+  size_t grain;
+
+public:
+  // Minimum number of instruction evaluations worth handing to a thread.
+  static constexpr size_t kGrain = 4096;
+
+  ParallelEvaluator(const std::vector<std::shared_ptr<Expression>> &outputs,
+                    const std::vector<std::string> &variables,
+                    ThreadPool &pool, size_t grain = kGrain);
+
+  size_t getLevelCount() const { return levelStart.size() - 1; }
+
+  // Same results as Tape::evaluate.
+  std::vector<double> evaluate(const std::vector<double> &point) const;
+  void evaluate(const std::vector<const double *> &columns, size_t count,
+                const std::vector<double *> &results) const;
+};
@@ -0,0 +1,43 @@
+#include "serializer.h"
+#include <iterator>
+#include <unordered_set>
+
+std::unordered_map<const Expression *, unsigned>
+serializer::sharedNodes(const Expression &expression) {
+  std::unordered_set<const Expression *> seen;
+  std::unordered_map<const Expression *, unsigned> shared;
+  std::vector<const Expression *> stack{&expression};
+  while (!stack.empty()) {
+    const Expression *node = stack.back();
+    stack.pop_back();
+    if (node->getKind() == Expression::Kind::Val ||
+        node->getKind() == Expression::Kind::Var) {
+      continue;
+    }
+    if (!seen.insert(node).second) {
+      shared.emplace(node, 0);
+      continue;
+    }
+    if (node->getKind() == Expression::Kind::Ln) {
+      stack.push_back(static_cast<const Ln &>(*node).getArgument().get());
+      continue;
+    }
+    const Binary &b = static_cast<const Binary &>(*node);
+    stack.push_back(b.getRight().get());
+    stack.push_back(b.getLeft().get());
+  }
+  return shared;
+}
+
+void writeTo(const Expression &expression, std::string &out) {
+  writeTo(expression, std::back_inserter(out));
+}
+
+void writeSharedTo(const Expression &expression, std::string &out) {
+  writeSharedTo(expression, std::back_inserter(out));
+}
+
+std::ostream &operator<<(std::ostream &os, const Expression &expression) {
+  writeTo(expression, std::ostreambuf_iterator<char>(os));
+  return os;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "expression.h"
+#include <algorithm>
+#include <charconv>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <version>
+
+#ifdef __cpp_lib_format
+#include <format>
+#endif
+
+// Single pass infix serialization into any character output iterator:
+// std::back_inserter(string), std::ostreambuf_iterator or a std::format
+// context. Nothing is buffered per node, so the cost is linear in the size of
+// the output, and the traversal keeps its own stack so that very deep trees
+// cannot overflow the call stack.
+
+namespace serializer {
+
+template <typename OutputIt>
+OutputIt writeLeaf(const Expression &expression, OutputIt out) {
+  if (expression.getKind() == Expression::Kind::Val) {
+    char digits[12];
+    char *end = std::to_chars(digits, digits + sizeof(digits),
+                              static_cast<const Val &>(expression).getValue())
+                    .ptr;
+    return std::copy(digits, end, out);
+  }
+  const std::string &name = static_cast<const Var &>(expression).getName();
+  return std::copy(name.begin(), name.end(), out);
+}
+
+template <typename OutputIt>
+OutputIt writeLabel(unsigned label, OutputIt out) {
+  *out++ = '#';
+  char digits[12];
+  char *end = std::to_chars(digits, digits + sizeof(digits), label).ptr;
+  return std::copy(digits, end, out);
+}
+
+// Operation nodes reachable through more than one parent.
+std::unordered_map<const Expression *, unsigned>
+sharedNodes(const Expression &expression);
+
+// Writes the tree; nodes present in `labels` are written once as `#n=...`
+// and referred to as `#n` afterwards. Labels are numbered in output order.
+template <typename OutputIt>
+OutputIt write(const Expression &expression, OutputIt out,
+               std::unordered_map<const Expression *, unsigned> *labels) {
+  unsigned nextLabel = 1;
+  std::vector<std::pair<const Expression *, int>> stack{{&expression, 0}};
+  while (!stack.empty()) {
+    const Expression *node = stack.back().first;
+    int state = stack.back().second++;
+    if (node->getKind() == Expression::Kind::Val ||
+        node->getKind() == Expression::Kind::Var) {
+      out = writeLeaf(*node, out);
+      stack.pop_back();
+      continue;
+    }
+    if (state == 0) {
+      if (labels) {
+        if (auto it = labels->find(node); it != labels->end()) {
+          if (it->second != 0) {
+            out = writeLabel(it->second, out);
+            stack.pop_back();
+            continue;
+          }
+          it->second = nextLabel++;
+          out = writeLabel(it->second, out);
+          *out++ = '=';
+        }
+      }
+    }
+    if (node->getKind() == Expression::Kind::Ln) {
+      if (state == 0) {
+        *out++ = 'l';
+        *out++ = 'n';
+        *out++ = '(';
+        const Ln &ln = static_cast<const Ln &>(*node);
+        stack.push_back({ln.getArgument().get(), 0});
+      } else {
+        *out++ = ')';
+        stack.pop_back();
+      }
+      continue;
+    }
+    const Binary &b = static_cast<const Binary &>(*node);
+    if (state == 0) {
+      *out++ = '(';
+      stack.push_back({b.getLeft().get(), 0});
+    } else if (state == 1) {
+      *out++ = ' ';
+      *out++ = b.getSign();
+      *out++ = ' ';
+      stack.push_back({b.getRight().get(), 0});
+    } else {
+      *out++ = ')';
+      stack.pop_back();
+    }
+  }
+  return out;
+}
+
+} // namespace serializer
+
+template <typename OutputIt>
+OutputIt writeTo(const Expression &expression, OutputIt out) {
+  return serializer::write(expression, out, nullptr);
+}
+
+// Like writeTo, but every subexpression shared by several parents is written
+// once and referenced by label afterwards, e.g. `(#1=(x + y) * #1)`. The
+// output stays linear in the size of the DAG rather than of its expansion.
+template <typename OutputIt>
+OutputIt writeSharedTo(const Expression &expression, OutputIt out) {
+  std::unordered_map<const Expression *, unsigned> labels =
+      serializer::sharedNodes(expression);
+  return serializer::write(expression, out, &labels);
+}
+
+void writeTo(const Expression &expression, std::string &out);
+void writeSharedTo(const Expression &expression, std::string &out);
+std::ostream &operator<<(std::ostream &os, const Expression &expression);
+
+#ifdef __cpp_lib_format
+template <> struct std::formatter<Expression> {
+  constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
+  auto format(const Expression &expression, std::format_context &ctx) const {
+    return writeTo(expression, ctx.out());
+  }
+};
+#endif
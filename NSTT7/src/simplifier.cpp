@@ -0,0 +1,338 @@
+#include "simplifier.h"
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using Kind = Expression::Kind;
+
+const Val *asVal(const std::shared_ptr<Expression> &e) {
+  return e->getKind() == Kind::Val ? static_cast<const Val *>(e.get())
+                                   : nullptr;
+}
+
+bool isVal(const std::shared_ptr<Expression> &e, int value) {
+  const Val *v = asVal(e);
+  return v && v->getValue() == value;
+}
+
+// Splits `c * t` into its constant coefficient and the remaining term.
+// Constants are always kept on the left of a simplified product.
+std::pair<int, std::shared_ptr<Expression>>
+splitCoefficient(const std::shared_ptr<Expression> &e) {
+  if (e->getKind() == Kind::Mult) {
+    const Mult &m = static_cast<const Mult &>(*e);
+    if (const Val *c = asVal(m.getLeft())) {
+      return {c->getValue(), m.getRight()};
+    }
+  }
+  return {1, e};
+}
+
+// Splits `t ^ n` into its base and constant exponent.
+std::pair<std::shared_ptr<Expression>, int>
+splitPower(const std::shared_ptr<Expression> &e) {
+  if (e->getKind() == Kind::Exponent) {
+    const Exponent &p = static_cast<const Exponent &>(*e);
+    if (const Val *n = asVal(p.getRight())) {
+      return {p.getLeft(), n->getValue()};
+    }
+  }
+  return {e, 1};
+}
+
+// Exponentiation by squaring, fails instead of overflowing.
+bool checkedPow(int base, int exponent, int &result) {
+  result = 1;
+  while (exponent > 0) {
+    if ((exponent & 1) && __builtin_mul_overflow(result, base, &result)) {
+      return false;
+    }
+    exponent >>= 1;
+    if (exponent > 0 && __builtin_mul_overflow(base, base, &base)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+std::shared_ptr<Expression> Simplifier::constant(int value) {
+  std::shared_ptr<Expression> &node = values[value];
+  if (!node) {
+    node = std::make_shared<Val>(value);
+    memo.try_emplace(node.get(), node, node);
+  }
+  return node;
+}
+
+std::shared_ptr<Expression> Simplifier::variable(const std::string &name) {
+  std::shared_ptr<Expression> &node = variables[name];
+  if (!node) {
+    node = std::make_shared<Var>(name);
+    memo.try_emplace(node.get(), node, node);
+  }
+  return node;
+}
+
+std::shared_ptr<Expression> Simplifier::intern(Kind kind,
+                                               std::shared_ptr<Expression> l,
+                                               std::shared_ptr<Expression> r) {
+  std::shared_ptr<Expression> &node = binaries[{kind, l.get(), r.get()}];
+  if (!node) {
+    node = Binary::make(kind, l, r);
+    memo.try_emplace(node.get(), node, node);
+  }
+  return node;
+}
+
+std::shared_ptr<Expression>
+Simplifier::simplify(const std::shared_ptr<Expression> &expression) {
+  // Post-order over the nodes that are not memoized yet. The traversal keeps
+  // its own stack so that very deep trees cannot overflow the call stack; a
+  // node is expanded first and rewritten once its children are simplified.
+  auto simplified = [this](const std::shared_ptr<Expression> &e) {
+    return memo.find(e.get())->second.second;
+  };
+  std::vector<std::pair<std::shared_ptr<Expression>, bool>> stack{
+      {expression, false}};
+  while (!stack.empty()) {
+    std::shared_ptr<Expression> node = stack.back().first;
+    if (memo.count(node.get())) {
+      stack.pop_back();
+      continue;
+    }
+    if (!stack.back().second) {
+      stack.back().second = true;
+      if (node->isBinary()) {
+        const Binary &b = static_cast<const Binary &>(*node);
+        stack.push_back({b.getRight(), false});
+        stack.push_back({b.getLeft(), false});
+      } else if (node->getKind() == Kind::Ln) {
+        stack.push_back({static_cast<const Ln &>(*node).getArgument(), false});
+      }
+      continue;
+    }
+    stack.pop_back();
+    std::shared_ptr<Expression> result;
+    if (node->isBinary()) {
+      const Binary &b = static_cast<const Binary &>(*node);
+      result = rewrite(b.getKind(), simplified(b.getLeft()),
+                       simplified(b.getRight()));
+    } else if (node->getKind() == Kind::Ln) {
+      result = rewriteLn(
+          simplified(static_cast<const Ln &>(*node).getArgument()));
+    } else if (const Val *v = asVal(node)) {
+      result = constant(v->getValue());
+    } else {
+      result = variable(static_cast<const Var &>(*node).getName());
+    }
+    memo.try_emplace(node.get(), node, result);
+    memo.try_emplace(result.get(), result, result);
+  }
+  return simplified(expression);
+}
+
+std::shared_ptr<Expression>
+Simplifier::simplifyNode(const std::shared_ptr<Expression> &node) {
+  if (node->isBinary()) {
+    const Binary &b = static_cast<const Binary &>(*node);
+    return rewrite(b.getKind(), simplify(b.getLeft()),
+                   simplify(b.getRight()));
+  }
+  if (node->getKind() == Kind::Ln) {
+    return rewriteLn(simplify(static_cast<const Ln &>(*node).getArgument()));
+  }
+  return simplify(node);
+}
+
+// Both operands are already in normal form. Whenever a rule builds a new node
+// it is rewritten again, so the returned node is a fixed point of all rules.
+std::shared_ptr<Expression> Simplifier::rewrite(Kind kind,
+                                                std::shared_ptr<Expression> l,
+                                                std::shared_ptr<Expression> r) {
+  switch (kind) {
+  case Kind::Add:
+    return rewriteAdd(l, r);
+  case Kind::Sub:
+    return rewriteSub(l, r);
+  case Kind::Mult:
+    return rewriteMult(l, r);
+  case Kind::Div:
+    return rewriteDiv(l, r);
+  case Kind::Exponent:
+    return rewriteExponent(l, r);
+  default:
+    throw std::invalid_argument("Unknown operation");
+  }
+}
+
+std::shared_ptr<Expression>
+Simplifier::rewriteAdd(std::shared_ptr<Expression> l,
+                       std::shared_ptr<Expression> r) {
+  const Val *lv = asVal(l), *rv = asVal(r);
+  int folded;
+  if (lv && rv &&
+      !__builtin_add_overflow(lv->getValue(), rv->getValue(), &folded)) {
+    return constant(folded);
+  }
+  if (isVal(l, 0)) {
+    return r;
+  }
+  if (isVal(r, 0)) {
+    return l;
+  }
+  auto [lc, lt] = splitCoefficient(l);
+  auto [rc, rt] = splitCoefficient(r);
+  if (!lv && lt == rt && !__builtin_add_overflow(lc, rc, &folded)) {
+    return rewriteMult(constant(folded), lt);
+  }
+  return intern(Kind::Add, l, r);
+}
+
+std::shared_ptr<Expression>
+Simplifier::rewriteSub(std::shared_ptr<Expression> l,
+                       std::shared_ptr<Expression> r) {
+  const Val *lv = asVal(l), *rv = asVal(r);
+  int folded;
+  if (lv && rv &&
+      !__builtin_sub_overflow(lv->getValue(), rv->getValue(), &folded)) {
+    return constant(folded);
+  }
+  if (isVal(r, 0)) {
+    return l;
+  }
+  if (l == r) {
+    return constant(0);
+  }
+  if (isVal(l, 0)) {
+    return rewriteMult(constant(-1), r);
+  }
+  auto [lc, lt] = splitCoefficient(l);
+  auto [rc, rt] = splitCoefficient(r);
+  if (!lv && lt == rt && !__builtin_sub_overflow(lc, rc, &folded)) {
+    return rewriteMult(constant(folded), lt);
+  }
+  return intern(Kind::Sub, l, r);
+}
+
+std::shared_ptr<Expression>
+Simplifier::rewriteMult(std::shared_ptr<Expression> l,
+                        std::shared_ptr<Expression> r) {
+  const Val *lv = asVal(l), *rv = asVal(r);
+  int folded;
+  if (lv && rv &&
+      !__builtin_mul_overflow(lv->getValue(), rv->getValue(), &folded)) {
+    return constant(folded);
+  }
+  if (isVal(l, 0) || isVal(r, 0)) {
+    return constant(0);
+  }
+  if (isVal(l, 1)) {
+    return r;
+  }
+  if (isVal(r, 1)) {
+    return l;
+  }
+  if (rv && !lv) {
+    return rewriteMult(r, l);
+  }
+  if (lv) {
+    auto [rc, rt] = splitCoefficient(r);
+    if (rt != r && !__builtin_mul_overflow(lv->getValue(), rc, &folded)) {
+      return rewriteMult(constant(folded), rt);
+    }
+    return intern(Kind::Mult, l, r);
+  }
+  auto [lb, ln] = splitPower(l);
+  auto [rb, rn] = splitPower(r);
+  if (lb == rb && !__builtin_add_overflow(ln, rn, &folded)) {
+    return rewriteExponent(lb, constant(folded));
+  }
+  return intern(Kind::Mult, l, r);
+}
+
+std::shared_ptr<Expression>
+Simplifier::rewriteDiv(std::shared_ptr<Expression> l,
+                       std::shared_ptr<Expression> r) {
+  const Val *lv = asVal(l), *rv = asVal(r);
+  if (lv && rv && rv->getValue() != 0 &&
+      !(lv->getValue() == std::numeric_limits<int>::min() &&
+        rv->getValue() == -1) &&
+      lv->getValue() % rv->getValue() == 0) {
+    return constant(lv->getValue() / rv->getValue());
+  }
+  if (isVal(r, 0)) {
+    return intern(Kind::Div, l, r);
+  }
+  if (isVal(l, 0)) {
+    return constant(0);
+  }
+  if (isVal(r, 1)) {
+    return l;
+  }
+  if (l == r) {
+    return constant(1);
+  }
+  return intern(Kind::Div, l, r);
+}
+
+std::shared_ptr<Expression>
+Simplifier::rewriteExponent(std::shared_ptr<Expression> l,
+                            std::shared_ptr<Expression> r) {
+  const Val *lv = asVal(l), *rv = asVal(r);
+  int folded;
+  if (lv && rv && rv->getValue() >= 0 &&
+      checkedPow(lv->getValue(), rv->getValue(), folded)) {
+    return constant(folded);
+  }
+  if (isVal(r, 0)) {
+    return constant(1);
+  }
+  if (isVal(r, 1)) {
+    return l;
+  }
+  if (isVal(l, 1)) {
+    return constant(1);
+  }
+  if (isVal(l, 0) && rv && rv->getValue() > 0) {
+    return constant(0);
+  }
+  if (rv) {
+    auto [base, n] = splitPower(l);
+    if (base != l && !__builtin_mul_overflow(n, rv->getValue(), &folded)) {
+      return rewriteExponent(base, constant(folded));
+    }
+  }
+  return intern(Kind::Exponent, l, r);
+}
+
+std::shared_ptr<Expression>
+Simplifier::rewriteLn(std::shared_ptr<Expression> argument) {
+  const Val *v = asVal(argument);
+  if (v && v->getValue() == 1) {
+    return constant(0);
+  }
+  std::shared_ptr<Expression> &node =
+      binaries[{Kind::Ln, argument.get(), nullptr}];
+  if (!node) {
+    node = std::make_shared<Ln>(argument);
+    memo.try_emplace(node.get(), node, node);
+  }
+  return node;
+}
+
+void Simplifier::clear() {
+  memo.clear();
+  binaries.clear();
+  values.clear();
+  variables.clear();
+}
+
+std::shared_ptr<Expression>
+simplify(const std::shared_ptr<Expression> &expression) {
+  Simplifier simplifier;
+  return simplifier.simplify(expression);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "expression.h"
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+// Rewrites expressions into a compact normal form: constants are folded,
+// neutral and absorbing elements are dropped and like terms are combined.
+//
+// Every node produced by a Simplifier is interned, so two structurally equal
+// results are the same object and can be compared by pointer. Results are
+// memoized per input node, which keeps repeated simplification of shared
+// subtrees (as produced by diff) linear in the number of distinct nodes.
+class Simplifier {
+  using Kind = Expression::Kind;
+  using BinaryKey = std::tuple<Kind, const Expression *, const Expression *>;
+
+  struct BinaryKeyHash {
+    size_t operator()(const BinaryKey &key) const {
+      size_t h = static_cast<size_t>(std::get<0>(key));
+      h = h * 31 + std::hash<const Expression *>()(std::get<1>(key));
+      h = h * 31 + std::hash<const Expression *>()(std::get<2>(key));
+      return h;
+    }
+  };
+
+  std::unordered_map<BinaryKey, std::shared_ptr<Expression>, BinaryKeyHash>
+      binaries;
+  std::unordered_map<int, std::shared_ptr<Expression>> values;
+  std::unordered_map<std::string, std::shared_ptr<Expression>> variables;
+
+  // Input node -> simplified node. The input is kept alive alongside its
+  // result so that its address cannot be reused by an unrelated node.
+  std::unordered_map<const Expression *,
+                     std::pair<std::shared_ptr<Expression>,
+                               std::shared_ptr<Expression>>>
+      memo;
+
+  std::shared_ptr<Expression> intern(Kind kind, std::shared_ptr<Expression> l,
+                                     std::shared_ptr<Expression> r);
+
+  std::shared_ptr<Expression> rewrite(Kind kind, std::shared_ptr<Expression> l,
+                                      std::shared_ptr<Expression> r);
+  std::shared_ptr<Expression> rewriteAdd(std::shared_ptr<Expression> l,
+                                         std::shared_ptr<Expression> r);
+  std::shared_ptr<Expression> rewriteSub(std::shared_ptr<Expression> l,
+                                         std::shared_ptr<Expression> r);
+  std::shared_ptr<Expression> rewriteMult(std::shared_ptr<Expression> l,
+                                          std::shared_ptr<Expression> r);
+  std::shared_ptr<Expression> rewriteDiv(std::shared_ptr<Expression> l,
+                                         std::shared_ptr<Expression> r);
+  std::shared_ptr<Expression> rewriteExponent(std::shared_ptr<Expression> l,
+                                              std::shared_ptr<Expression> r);
+  std::shared_ptr<Expression> rewriteLn(std::shared_ptr<Expression> argument);
+
+public:
+  virtual ~Simplifier() = default;
+
+  // Simplifies the whole tree until no rule applies anymore.
+  std::shared_ptr<Expression>
+  simplify(const std::shared_ptr<Expression> &expression);
+
+  // Simplifies a freshly built node whose children may be unsimplified.
+  // The node itself is not memoized, which keeps temporaries out of the memo.
+  std::shared_ptr<Expression>
+  simplifyNode(const std::shared_ptr<Expression> &node);
+
+  std::shared_ptr<Expression> constant(int value);
+  std::shared_ptr<Expression> variable(const std::string &name);
+
+  // Called by diff for every child it differentiates. Subclasses may answer
+  // from a cache instead of recursing.
+  virtual std::shared_ptr<Expression>
+  derivative(const std::shared_ptr<Expression> &expression,
+             const std::string &variable) {
+    return expression->diff(variable, this);
+  }
+
+  // Number of distinct nodes created so far.
+  size_t size() const {
+    return binaries.size() + values.size() + variables.size();
+  }
+
+  void clear();
+};
+
+std::shared_ptr<Expression>
+simplify(const std::shared_ptr<Expression> &expression);
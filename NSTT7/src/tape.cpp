@@ -0,0 +1,354 @@
+#include "tape.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+struct AddLanes {
+  static double scalar(double a, double b) { return a + b; }
+#if defined(__AVX__)
+  static __m256d vector(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+#elif defined(__SSE2__)
+  static __m128d vector(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+#endif
+};
+
+struct SubLanes {
+  static double scalar(double a, double b) { return a - b; }
+#if defined(__AVX__)
+  static __m256d vector(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+#elif defined(__SSE2__)
+  static __m128d vector(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+#endif
+};
+
+struct MultLanes {
+  static double scalar(double a, double b) { return a * b; }
+#if defined(__AVX__)
+  static __m256d vector(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+#elif defined(__SSE2__)
+  static __m128d vector(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+#endif
+};
+
+struct DivLanes {
+  static double scalar(double a, double b) { return a / b; }
+#if defined(__AVX__)
+  static __m256d vector(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+#elif defined(__SSE2__)
+  static __m128d vector(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+#endif
+};
+
+// dst may alias a or b: every lane is loaded before it is stored.
+template <typename Lanes>
+void apply(double *dst, const double *a, const double *b, size_t count) {
+  size_t i = 0;
+#if defined(__AVX__)
+  for (; i + 4 <= count; i += 4) {
+    _mm256_storeu_pd(dst + i, Lanes::vector(_mm256_loadu_pd(a + i),
+                                            _mm256_loadu_pd(b + i)));
+  }
+#elif defined(__SSE2__)
+  for (; i + 2 <= count; i += 2) {
+    _mm_storeu_pd(dst + i,
+                  Lanes::vector(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = Lanes::scalar(a[i], b[i]);
+  }
+}
+
+Tape::Op opOf(Expression::Kind kind) {
+  switch (kind) {
+  case Expression::Kind::Add:
+    return Tape::Op::Add;
+  case Expression::Kind::Sub:
+    return Tape::Op::Sub;
+  case Expression::Kind::Mult:
+    return Tape::Op::Mult;
+  case Expression::Kind::Div:
+    return Tape::Op::Div;
+  case Expression::Kind::Exponent:
+    return Tape::Op::Pow;
+  default:
+    throw std::invalid_argument("Unknown operation");
+  }
+}
+
+// Builds the SSA form of the program: value i is computed by instruction i.
+class Compiler {
+  using Key = std::tuple<Tape::Op, uint32_t, uint32_t>;
+
+  const std::vector<std::string> &variables;
+  std::unordered_map<const Expression *, uint32_t> visited;
+  std::map<Key, uint32_t> numbered;
+  std::map<double, uint32_t> constants;
+
+  uint32_t emit(Tape::Op op, uint32_t a, uint32_t b, double value) {
+    program.push_back({op, static_cast<uint32_t>(program.size()), a, b, value});
+    return program.back().dst;
+  }
+
+  // Value number of `e`, whose children have been compiled already.
+  uint32_t number(const Expression &e) {
+    if (e.isBinary()) {
+      const Binary &b = static_cast<const Binary &>(e);
+      uint32_t l = visited.at(b.getLeft().get());
+      uint32_t r = visited.at(b.getRight().get());
+      Tape::Op op = opOf(b.getKind());
+      if ((op == Tape::Op::Add || op == Tape::Op::Mult) && r < l) {
+        std::swap(l, r);
+      }
+      auto [it, inserted] = numbered.try_emplace({op, l, r}, 0);
+      if (inserted) {
+        it->second = emit(op, l, r, 0);
+      }
+      return it->second;
+    }
+    if (e.getKind() == Expression::Kind::Ln) {
+      uint32_t a = visited.at(static_cast<const Ln &>(e).getArgument().get());
+      auto [it, inserted] = numbered.try_emplace({Tape::Op::Log, a, a}, 0);
+      if (inserted) {
+        it->second = emit(Tape::Op::Log, a, a, 0);
+      }
+      return it->second;
+    }
+    if (e.getKind() == Expression::Kind::Val) {
+      int value = static_cast<const Val &>(e).getValue();
+      auto [it, inserted] = constants.try_emplace(value, 0);
+      if (inserted) {
+        it->second = emit(Tape::Op::Const, 0, 0, value);
+      }
+      return it->second;
+    }
+    const std::string &name = static_cast<const Var &>(e).getName();
+    auto column = std::find(variables.begin(), variables.end(), name);
+    if (column == variables.end()) {
+      throw std::invalid_argument("Unknown variable: " + name);
+    }
+    uint32_t index = column - variables.begin();
+    auto [it, inserted] = numbered.try_emplace({Tape::Op::Input, index, 0}, 0);
+    if (inserted) {
+      it->second = emit(Tape::Op::Input, index, 0, 0);
+    }
+    return it->second;
+  }
+
+public:
+  std::vector<Tape::Instruction> program;
+
+  Compiler(const std::vector<std::string> &variables) : variables(variables) {}
+
+  uint32_t compile(const std::shared_ptr<Expression> &expression) {
+    // Post-order with an explicit stack, as in ExpressionArena::import, so
+    // that very deep trees cannot overflow the call stack.
+    std::vector<std::pair<const Expression *, bool>> stack{
+        {expression.get(), false}};
+    while (!stack.empty()) {
+      auto [e, expanded] = stack.back();
+      if (visited.count(e)) {
+        stack.pop_back();
+        continue;
+      }
+      if (!expanded) {
+        stack.back().second = true;
+        if (e->isBinary()) {
+          const Binary &b = static_cast<const Binary &>(*e);
+          stack.push_back({b.getRight().get(), false});
+          stack.push_back({b.getLeft().get(), false});
+        } else if (e->getKind() == Expression::Kind::Ln) {
+          stack.push_back(
+              {static_cast<const Ln &>(*e).getArgument().get(), false});
+        }
+        continue;
+      }
+      stack.pop_back();
+      visited.emplace(e, number(*e));
+    }
+    return visited.at(expression.get());
+  }
+};
+
+} // namespace
+
+double Tape::compute(Op op, double a, double b) {
+  switch (op) {
+  case Op::Add:
+    return a + b;
+  case Op::Sub:
+    return a - b;
+  case Op::Mult:
+    return a * b;
+  case Op::Div:
+    return a / b;
+  case Op::Pow:
+    return std::pow(a, b);
+  case Op::Log:
+    return std::log(a);
+  default:
+    throw std::logic_error("Not a binary operation");
+  }
+}
+
+Tape::Tape(const std::shared_ptr<Expression> &expression,
+           const std::vector<std::string> &variables, bool reuseRegisters)
+    : Tape(std::vector<std::shared_ptr<Expression>>{expression}, variables,
+           reuseRegisters) {}
+
+Tape::Tape(const std::vector<std::shared_ptr<Expression>> &outputs,
+           const std::vector<std::string> &variables, bool reuseRegisters)
+    : variables(variables) {
+  Compiler compiler(variables);
+  std::vector<uint32_t> values;
+  for (const std::shared_ptr<Expression> &output : outputs) {
+    values.push_back(compiler.compile(output));
+  }
+  instructions = std::move(compiler.program);
+  if (!reuseRegisters) {
+    registerCount = instructions.size();
+    this->outputs = values;
+    return;
+  }
+
+  // Linear scan over the SSA program: a register is released right after
+  // its value is read for the last time. Outputs stay alive until the end.
+  constexpr uint32_t kLive = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> lastUse(instructions.size(), 0);
+  for (const Instruction &ins : instructions) {
+    if (ins.op != Op::Input && ins.op != Op::Const) {
+      lastUse[ins.a] = lastUse[ins.b] = ins.dst;
+    }
+  }
+  for (uint32_t value : values) {
+    lastUse[value] = kLive;
+  }
+
+  std::vector<uint32_t> location(instructions.size());
+  std::vector<uint32_t> free;
+  for (Instruction &ins : instructions) {
+    uint32_t value = ins.dst;
+    if (ins.op != Op::Input && ins.op != Op::Const) {
+      uint32_t a = ins.a, b = ins.b;
+      ins.a = location[a];
+      ins.b = location[b];
+      if (lastUse[a] == value) {
+        free.push_back(location[a]);
+      }
+      if (b != a && lastUse[b] == value) {
+        free.push_back(location[b]);
+      }
+    }
+    if (free.empty()) {
+      location[value] = registerCount++;
+    } else {
+      location[value] = free.back();
+      free.pop_back();
+    }
+    ins.dst = location[value];
+  }
+  for (uint32_t value : values) {
+    this->outputs.push_back(location[value]);
+  }
+}
+
+std::vector<double> Tape::evaluate(const std::vector<double> &point) const {
+  if (point.size() != variables.size()) {
+    throw std::invalid_argument("Wrong number of variables");
+  }
+  std::vector<double> registers(registerCount);
+  for (const Instruction &ins : instructions) {
+    switch (ins.op) {
+    case Op::Input:
+      registers[ins.dst] = point[ins.a];
+      break;
+    case Op::Const:
+      registers[ins.dst] = ins.value;
+      break;
+    default:
+      registers[ins.dst] =
+          compute(ins.op, registers[ins.a], registers[ins.b]);
+    }
+  }
+  std::vector<double> result;
+  for (uint32_t output : outputs) {
+    result.push_back(registers[output]);
+  }
+  return result;
+}
+
+void Tape::evaluate(const std::vector<const double *> &columns, size_t count,
+                    const std::vector<double *> &results) const {
+  if (columns.size() != variables.size()) {
+    throw std::invalid_argument("Wrong number of variables");
+  }
+  if (results.size() != outputs.size()) {
+    throw std::invalid_argument("Wrong number of outputs");
+  }
+  std::vector<double> registers(registerCount * kBlock);
+  for (size_t offset = 0; offset < count; offset += kBlock) {
+    evaluateBlock(columns, offset, std::min(kBlock, count - offset),
+                  registers.data(), results);
+  }
+}
+
+void Tape::evaluateBlock(const std::vector<const double *> &columns,
+                         size_t offset, size_t count, double *registers,
+                         const std::vector<double *> &results) const {
+  // Lanes past `count` are computed too so the vector loops need no tail;
+  // they start from zeroed inputs and are never copied out.
+  size_t lanes = std::min(kBlock, (count + 3) & ~size_t{3});
+  for (const Instruction &ins : instructions) {
+    double *dst = registers + ins.dst * kBlock;
+    const double *a = registers + ins.a * kBlock;
+    const double *b = registers + ins.b * kBlock;
+    switch (ins.op) {
+    case Op::Input:
+      memcpy(dst, columns[ins.a] + offset, count * sizeof(double));
+      std::fill(dst + count, dst + lanes, 0.0);
+      break;
+    case Op::Const:
+      std::fill(dst, dst + lanes, ins.value);
+      break;
+    case Op::Add:
+      apply<AddLanes>(dst, a, b, lanes);
+      break;
+    case Op::Sub:
+      apply<SubLanes>(dst, a, b, lanes);
+      break;
+    case Op::Mult:
+      apply<MultLanes>(dst, a, b, lanes);
+      break;
+    case Op::Div:
+      apply<DivLanes>(dst, a, b, lanes);
+      break;
+    case Op::Pow:
+      for (size_t i = 0; i < lanes; ++i) {
+        dst[i] = std::pow(a[i], b[i]);
+      }
+      break;
+    case Op::Log:
+      for (size_t i = 0; i < lanes; ++i) {
+        dst[i] = std::log(a[i]);
+      }
+      break;
+    }
+  }
+  for (size_t j = 0; j < outputs.size(); ++j) {
+    memcpy(results[j] + offset, registers + outputs[j] * kBlock,
+           count * sizeof(double));
+  }
+}
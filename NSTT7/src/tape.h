@@ -0,0 +1,68 @@
+#pragma once
+
+#include "expression.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Straight-line register program compiled from one or more expressions.
+//
+// The expression DAG is walked once at compile time: equal subexpressions
+// are merged by value numbering and registers are reused as soon as their
+// last reader has run. Evaluation then streams columns of inputs
+// (one array per variable) through the program block by block, so every
+// instruction processes a whole block of points with vector instructions.
+class Tape {
+public:
+  enum class Op : uint8_t { Input, Const, Add, Sub, Mult, Div, Pow, Log };
+
+  struct Instruction {
+    Op op;
+    uint32_t dst;
+    // Operand registers; for Input `a` is the input column, Log reads only
+    // `a` and has `b == a`.
+    uint32_t a, b;
+    // Only used by Const.
+    double value;
+  };
+
+  // Points evaluated together by one pass over the instructions.
+  static constexpr size_t kBlock = 256;
+
+  // Without register reuse the tape stays in SSA form: instruction i writes
+  // register i, so every intermediate value survives the evaluation.
+  Tape(const std::shared_ptr<Expression> &expression,
+       const std::vector<std::string> &variables, bool reuseRegisters = true);
+  Tape(const std::vector<std::shared_ptr<Expression>> &outputs,
+       const std::vector<std::string> &variables, bool reuseRegisters = true);
+
+  const std::vector<Instruction> &getInstructions() const {
+    return instructions;
+  }
+  const std::vector<std::string> &getVariables() const { return variables; }
+  const std::vector<uint32_t> &getOutputs() const { return outputs; }
+  size_t getRegisterCount() const { return registerCount; }
+
+  // Result of a single arithmetic instruction.
+  static double compute(Op op, double a, double b);
+
+  // Evaluates all outputs at a single point.
+  std::vector<double> evaluate(const std::vector<double> &point) const;
+
+  // columns[i][k] is the value of variables[i] at point k and
+  // results[j][k] receives output j at point k.
+  void evaluate(const std::vector<const double *> &columns, size_t count,
+                const std::vector<double *> &results) const;
+
+  // Evaluates points [offset, offset + count), count <= kBlock. Register r
+  // occupies registers[r * kBlock, (r + 1) * kBlock).
+  void evaluateBlock(const std::vector<const double *> &columns,
+                     size_t offset, size_t count, double *registers,
+                     const std::vector<double *> &results) const;
+
+private:
+  std::vector<Instruction> instructions;
+  std::vector<std::string> variables;
+  std::vector<uint32_t> outputs;
+  size_t registerCount = 0;
+};
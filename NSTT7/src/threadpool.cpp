@@ -0,0 +1,75 @@
+#include "threadpool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+  for (unsigned i = 1; i < threads; ++i) {
+    workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::work() {
+  unsigned seen = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [&] { return stopping || generation != seen; });
+    if (stopping) {
+      return;
+    }
+    seen = generation;
+    const std::function<void(size_t, size_t)> *fn = body;
+    size_t total = count, step = chunk;
+    ++active;
+    lock.unlock();
+    // A worker that wakes up after the loop is over finds no chunk left and
+    // never touches `fn`.
+    runChunks(fn, total, step);
+    lock.lock();
+    if (--active == 0) {
+      done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::runChunks(const std::function<void(size_t, size_t)> *fn,
+                           size_t total, size_t step) {
+  for (size_t begin; (begin = next.fetch_add(step)) < total;) {
+    (*fn)(begin, std::min(begin + step, total));
+  }
+}
+
+void ThreadPool::parallelFor(size_t n, size_t grain,
+                             const std::function<void(size_t, size_t)> &fn) {
+  size_t tasks = std::min<size_t>(size(), n / std::max<size_t>(grain, 1));
+  if (tasks <= 1) {
+    if (n > 0) {
+      fn(0, n);
+    }
+    return;
+  }
+  // Several chunks per thread let fast threads pick up the slack.
+  size_t step = std::max(grain, (n + tasks * 4 - 1) / (tasks * 4));
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return active == 0; });
+    body = &fn;
+    count = n;
+    chunk = step;
+    next = 0;
+    ++generation;
+  }
+  wake.notify_all();
+  runChunks(&fn, n, step);
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return active == 0; });
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running one parallel loop at a time.
+//
+// Work is handed out in chunks from a shared counter, so threads that finish
+// early keep taking chunks from the others. The calling thread works too and
+// parallelFor returns only when every chunk has run.
+class ThreadPool {
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake, done;
+  bool stopping = false;
+
+  // The current loop. Workers copy it under the mutex; `active` counts the
+  // workers that may still be running chunks of it.
+  unsigned generation = 0;
+  unsigned active = 0;
+  const std::function<void(size_t, size_t)> *body = nullptr;
+  size_t count = 0, chunk = 0;
+  std::atomic<size_t> next{0};
+
+  void work();
+  void runChunks(const std::function<void(size_t, size_t)> *fn, size_t total,
+                 size_t step);
+
+public:
+  // `threads` includes the caller, so 1 means no worker threads at all.
+  explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned size() const { return workers.size() + 1; }
+
+  // Calls fn(begin, end) for disjoint ranges covering [0, n). Ranges hold at
+  // least `grain` items, so small loops run on the calling thread only. Not
+  // reentrant: `fn` must not call parallelFor on the same pool.
+  void parallelFor(size_t n, size_t grain,
+                   const std::function<void(size_t, size_t)> &fn);
+};
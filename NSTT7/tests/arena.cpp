@@ -0,0 +1,93 @@
+#include "../src/arena.h"
+#include "../src/serializer.h"
+#include <gtest/gtest.h>
+
+TEST(ArenaTest, HashConsing) {
+  ExpressionArena arena;
+  using Kind = ExpressionArena::Kind;
+  ExpressionArena::Id x = arena.variable("x");
+  ExpressionArena::Id a = arena.make(Kind::Add, x, arena.constant(2));
+  ExpressionArena::Id b =
+      arena.make(Kind::Add, arena.variable("x"), arena.constant(2));
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(arena.size(), 3);
+  EXPECT_EQ(arena[a].kind, Kind::Add);
+  EXPECT_EQ(arena.getName(arena[a].left), "x");
+}
+
+TEST(ArenaTest, Folding) {
+  ExpressionArena arena;
+  using Kind = ExpressionArena::Kind;
+  ExpressionArena::Id x = arena.variable("x");
+  ExpressionArena::Id e = arena.make(
+      Kind::Add, arena.make(Kind::Mult, x, arena.constant(0)),
+      arena.make(Kind::Mult, arena.constant(3), arena.constant(4)));
+  EXPECT_EQ(arena.toString(e), "12");
+  EXPECT_EQ(arena.make(Kind::Exponent, x, arena.constant(1)), x);
+}
+
+TEST(ArenaTest, ImportRoundTrip) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> e = std::make_shared<Div>(
+      std::make_shared<Add>(x, std::make_shared<Val>(0)),
+      std::make_shared<Exponent>(x, std::make_shared<Val>(2)));
+  ExpressionArena arena;
+  ExpressionArena::Id id = arena.import(e);
+  EXPECT_EQ(arena.toString(id), e->toStringStream().str());
+  EXPECT_EQ(arena.toExpression(id)->toStringStream().str(),
+            e->toStringStream().str());
+}
+
+TEST(ArenaTest, DeepTree) {
+  std::shared_ptr<Expression> e = std::make_shared<Var>("x");
+  size_t depth = 200000;
+  for (size_t i = 0; i < depth; ++i) {
+    e = std::make_shared<Add>(e, std::make_shared<Val>(1));
+  }
+  ExpressionArena arena;
+  ExpressionArena::Id id = arena.import(e);
+  std::string out = arena.toString(id);
+  EXPECT_EQ(out.size(), 1 + depth * 6);
+  EXPECT_TRUE(out.ends_with(" + 1) + 1)"));
+  EXPECT_EQ(arena.toString(arena.diff(id, "x")), "1");
+
+  std::shared_ptr<Expression> back = arena.toExpression(id);
+  std::string written;
+  writeTo(*back, written);
+  EXPECT_EQ(written, out);
+
+  // Tear the chains down iteratively, the recursive destructor of a tree
+  // this deep would overflow the stack.
+  for (std::shared_ptr<Expression> *chain : {&e, &back}) {
+    while ((*chain)->isBinary()) {
+      *chain = static_cast<const Binary &>(**chain).getLeft();
+    }
+  }
+}
+
+TEST(ArenaTest, Diff) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> y = std::make_shared<Var>("y");
+  std::shared_ptr<Expression> e = std::make_shared<Add>(
+      std::make_shared<Mult>(x, y),
+      std::make_shared<Exponent>(x, std::make_shared<Val>(3)));
+  ExpressionArena arena;
+  ExpressionArena::Id id = arena.import(e);
+  EXPECT_EQ(arena.toString(arena.diff(id, "x")), "(y + (3 * (x ^ 2)))");
+  EXPECT_EQ(arena.toString(arena.diff(id, "y")), "x");
+  EXPECT_EQ(arena.toString(arena.diff(id, "z")), "0");
+}
+
+TEST(ArenaTest, DiffChainRule) {
+  ExpressionArena arena;
+  using Kind = ExpressionArena::Kind;
+  ExpressionArena::Id e =
+      arena.make(Kind::Exponent, arena.constant(2), arena.variable("x"));
+  EXPECT_EQ(arena.toString(arena.diff(e, "x")), "((2 ^ x) * ln(2))");
+
+  ExpressionArena::Id l = arena.ln(arena.make(
+      Kind::Mult, arena.variable("x"), arena.variable("x")));
+  EXPECT_EQ(arena.toString(arena.diff(l, "x")),
+            "((x + x) / (x * x))");
+  EXPECT_EQ(arena.toExpression(l)->toStringStream().str(), "ln((x * x))");
+}
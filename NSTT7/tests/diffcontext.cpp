@@ -0,0 +1,69 @@
+#include "../src/diffcontext.h"
+#include "../src/parser.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+std::shared_ptr<Expression> parse(Parser &parser, const char *text) {
+  ParseError error;
+  std::shared_ptr<Expression> e = parser.parse(text, error);
+  EXPECT_FALSE(error) << error.message;
+  return e;
+}
+
+} // namespace
+
+TEST(DiffContextTest, ChainRule) {
+  Parser parser;
+  DiffContext context;
+  EXPECT_EQ(context.diff(parse(parser, "2 ^ x"), "x")->toStringStream().str(),
+            "((2 ^ x) * ln(2))");
+  EXPECT_EQ(context.diff(parse(parser, "x ^ x"), "x")->toStringStream().str(),
+            "((x ^ x) * (ln(x) + 1))");
+  EXPECT_EQ(context.diff(parse(parser, "ln(y)"), "y")->toStringStream().str(),
+            "(1 / y)");
+}
+
+TEST(DiffContextTest, Cache) {
+  Parser parser;
+  DiffContext context;
+  std::shared_ptr<Expression> e = parse(parser, "x * y ^ 3");
+  std::shared_ptr<Expression> first = context.diff(e, "y");
+  size_t size = context.size();
+  EXPECT_EQ(context.diff(parse(parser, "x * y ^ 3"), "y"), first);
+  EXPECT_EQ(context.size(), size);
+}
+
+TEST(DiffContextTest, DiffN) {
+  Parser parser;
+  DiffContext context;
+  std::shared_ptr<Expression> e = parse(parser, "x ^ 4");
+  EXPECT_EQ(context.diffN(e, "x", 0)->toStringStream().str(), "(x ^ 4)");
+  EXPECT_EQ(context.diffN(e, "x", 2)->toStringStream().str(),
+            "(12 * (x ^ 2))");
+  EXPECT_EQ(context.diffN(e, "x", 5)->toStringStream().str(), "0");
+  EXPECT_EQ(context.diffN(e, "x", 2), context.diffN(e, "x", 2));
+}
+
+TEST(DiffContextTest, Jacobian) {
+  Parser parser;
+  DiffContext context;
+  auto j = context.jacobian({parse(parser, "x * y"), parse(parser, "x + y")},
+                            {"x", "y"});
+  ASSERT_EQ(j.size(), 2);
+  EXPECT_EQ(j[0][0]->toStringStream().str(), "y");
+  EXPECT_EQ(j[0][1]->toStringStream().str(), "x");
+  EXPECT_EQ(j[1][0]->toStringStream().str(), "1");
+  EXPECT_EQ(j[1][1], j[1][0]);
+}
+
+TEST(DiffContextTest, Hessian) {
+  Parser parser;
+  DiffContext context;
+  auto h = context.hessian(parse(parser, "x ^ 2 * y"), {"x", "y"});
+  ASSERT_EQ(h.size(), 2);
+  EXPECT_EQ(h[0][0]->toStringStream().str(), "(2 * y)");
+  EXPECT_EQ(h[0][1]->toStringStream().str(), "(2 * x)");
+  EXPECT_EQ(h[1][0], h[0][1]);
+  EXPECT_EQ(h[1][1]->toStringStream().str(), "0");
+}
@@ -52,7 +52,22 @@ TEST(DiffTest, ExpConstVar) {
   std::shared_ptr<Expression> a = std::make_shared<Val>(2);
   std::shared_ptr<Expression> b = std::make_shared<Var>("x");
   std::shared_ptr<Expression> c = std::make_shared<Exponent>(a, b);
-  ASSERT_THROW(c->diff("x")->toStringStream().str(), std::runtime_error);
+  EXPECT_EQ(c->diff("x")->toStringStream().str(), "((2 ^ x) * (ln(2) * 1))");
+}
+
+TEST(DiffTest, ExpVarVar) {
+  std::shared_ptr<Expression> a = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> c = std::make_shared<Exponent>(a, a);
+  EXPECT_EQ(c->diff("x")->toStringStream().str(),
+            "((x ^ x) * ((1 * ln(x)) + ((x * 1) / x)))");
+}
+
+TEST(DiffTest, Ln) {
+  std::shared_ptr<Expression> a = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> b = std::make_shared<Mult>(a, a);
+  std::shared_ptr<Expression> c = std::make_shared<Ln>(b);
+  EXPECT_EQ(c->diff("x")->toStringStream().str(),
+            "(((1 * x) + (x * 1)) / (x * x))");
 }
 
 TEST(DiffTest, ExpConstConst) {
@@ -0,0 +1,99 @@
+#include "../src/gradient.h"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+// f(x, y, z) = (x * y + z) ^ 2 / (y - z) + x ^ y
+std::shared_ptr<Expression> gradientSample() {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> y = std::make_shared<Var>("y");
+  std::shared_ptr<Expression> z = std::make_shared<Var>("z");
+  return std::make_shared<Add>(
+      std::make_shared<Div>(
+          std::make_shared<Exponent>(
+              std::make_shared<Add>(std::make_shared<Mult>(x, y), z),
+              std::make_shared<Val>(2)),
+          std::make_shared<Sub>(y, z)),
+      std::make_shared<Exponent>(x, y));
+}
+
+void expectSampleGradient(double x, double y, double z, double value,
+                          const double *gradient) {
+  double u = x * y + z, d = y - z;
+  EXPECT_NEAR(value, u * u / d + std::pow(x, y), 1e-9);
+  EXPECT_NEAR(gradient[0], 2 * u * y / d + y * std::pow(x, y - 1), 1e-9);
+  EXPECT_NEAR(gradient[1],
+              2 * u * x / d - u * u / (d * d) + std::pow(x, y) * std::log(x),
+              1e-9);
+  EXPECT_NEAR(gradient[2], 2 * u / d + u * u / (d * d), 1e-9);
+}
+
+} // namespace
+
+TEST(GradientTest, Point) {
+  Gradient gradient(gradientSample(), {"x", "y", "z"});
+  std::vector<double> result;
+  double value = gradient.evaluate({2, 3, 0.5}, result);
+  ASSERT_EQ(result.size(), 3);
+  expectSampleGradient(2, 3, 0.5, value, result.data());
+}
+
+TEST(GradientTest, UnusedVariable) {
+  std::shared_ptr<Expression> e = std::make_shared<Mult>(
+      std::make_shared<Var>("x"), std::make_shared<Var>("x"));
+  Gradient gradient(e, {"x", "y"});
+  std::vector<double> result;
+  EXPECT_DOUBLE_EQ(gradient.evaluate({3, 7}, result), 9);
+  EXPECT_DOUBLE_EQ(result[0], 6);
+  EXPECT_DOUBLE_EQ(result[1], 0);
+}
+
+TEST(GradientTest, MoreVariablesThanSlots) {
+  // The tape has a single slot, but the input reads column 1.
+  Gradient gradient(std::make_shared<Var>("y"), {"x", "y"});
+  std::vector<double> result;
+  EXPECT_DOUBLE_EQ(gradient.evaluate({1, 2}, result), 2);
+  EXPECT_EQ(result, (std::vector<double>{0, 1}));
+  EXPECT_THROW(gradient.evaluate({1}, result), std::invalid_argument);
+
+  std::vector<double> xs{1, 3}, ys{2, 4}, values(2), dx(2), dy(2);
+  gradient.evaluate({xs.data(), ys.data()}, 2, values.data(),
+                    {dx.data(), dy.data()});
+  EXPECT_EQ(values, ys);
+  EXPECT_EQ(dx, (std::vector<double>{0, 0}));
+  EXPECT_EQ(dy, (std::vector<double>{1, 1}));
+  EXPECT_THROW(gradient.evaluate({xs.data()}, 2, values.data(),
+                                 {dx.data(), dy.data()}),
+               std::invalid_argument);
+}
+
+TEST(GradientTest, Batch) {
+  Gradient gradient(gradientSample(), {"x", "y", "z"});
+  size_t count = 600;
+  std::vector<double> xs(count), ys(count), zs(count), values(count);
+  std::vector<double> dx(count), dy(count), dz(count);
+  for (size_t i = 0; i < count; ++i) {
+    xs[i] = 1 + i * 0.01;
+    ys[i] = 2 + i * 0.001;
+    zs[i] = 0.5 - i * 0.002;
+  }
+  gradient.evaluate({xs.data(), ys.data(), zs.data()}, count, values.data(),
+                    {dx.data(), dy.data(), dz.data()});
+  for (size_t i = 0; i < count; ++i) {
+    double g[] = {dx[i], dy[i], dz[i]};
+    expectSampleGradient(xs[i], ys[i], zs[i], values[i], g);
+  }
+}
+
+TEST(GradientTest, Ln) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> y = std::make_shared<Var>("y");
+  Gradient gradient(std::make_shared<Mult>(std::make_shared<Ln>(x), y),
+                    {"x", "y"});
+  std::vector<double> result;
+  double value = gradient.evaluate({3, 2}, result);
+  EXPECT_NEAR(value, 2 * std::log(3.0), 1e-12);
+  EXPECT_NEAR(result[0], 2 / 3.0, 1e-12);
+  EXPECT_NEAR(result[1], std::log(3.0), 1e-12);
+}
@@ -0,0 +1,116 @@
+#include "../src/parser.h"
+#include <climits>
+#include <gtest/gtest.h>
+
+TEST(ParserTest, Precedence) {
+  Parser parser;
+  ParseError error;
+  std::shared_ptr<Expression> e =
+      parser.parse("a + b * c ^ 2 ^ n - d / 4", error);
+  ASSERT_FALSE(error);
+  EXPECT_EQ(e->toStringStream().str(),
+            "((a + (b * (c ^ (2 ^ n)))) - (d / 4))");
+}
+
+TEST(ParserTest, UnaryMinus) {
+  Parser parser;
+  ParseError error;
+  EXPECT_EQ(parser.parse("-x^2", error)->toStringStream().str(),
+            "(-1 * (x ^ 2))");
+  EXPECT_EQ(parser.parse("2 ^ -3 * -(y)", error)->toStringStream().str(),
+            "((2 ^ -3) * (-1 * y))");
+}
+
+TEST(ParserTest, RoundTrip) {
+  Parser parser;
+  ParseError error;
+  std::string text = "((x - (-12 * y)) / ((x ^ 2) + 7))";
+  std::shared_ptr<Expression> e = parser.parse(text, error);
+  ASSERT_FALSE(error);
+  EXPECT_EQ(e->toStringStream().str(), text);
+}
+
+TEST(ParserTest, InternedLeaves) {
+  Parser parser;
+  ParseError error;
+  std::shared_ptr<Expression> a = parser.parse("x + 1", error);
+  std::shared_ptr<Expression> b = parser.parse("x * 1", error);
+  const Binary &ab = static_cast<const Binary &>(*a);
+  const Binary &bb = static_cast<const Binary &>(*b);
+  EXPECT_EQ(ab.getLeft(), bb.getLeft());
+  EXPECT_EQ(ab.getRight(), bb.getRight());
+}
+
+TEST(ParserTest, Errors) {
+  Parser parser;
+  ParseError error;
+  EXPECT_EQ(parser.parse("x + * y", error), nullptr);
+  EXPECT_EQ(error.position, 4);
+  EXPECT_STREQ(error.message, "Expected a number, a variable or '('");
+
+  EXPECT_EQ(parser.parse("(x + y", error), nullptr);
+  EXPECT_EQ(error.position, 6);
+  EXPECT_STREQ(error.message, "Expected ')'");
+
+  EXPECT_EQ(parser.parse("x y", error), nullptr);
+  EXPECT_EQ(error.position, 2);
+  EXPECT_STREQ(error.message, "Unexpected character");
+
+  EXPECT_EQ(parser.parse("99999999999", error), nullptr);
+  EXPECT_STREQ(error.message, "Integer literal out of range");
+
+  EXPECT_EQ(parser.parse("2147483648", error), nullptr);
+  EXPECT_STREQ(error.message, "Integer literal out of range");
+  EXPECT_EQ(parser.parse("-2147483648 ^ 2", error), nullptr);
+  EXPECT_STREQ(error.message, "Integer literal out of range");
+
+  std::string deep(10000, '(');
+  EXPECT_EQ(parser.parse(deep + "x", error), nullptr);
+  EXPECT_STREQ(error.message, "Expression is nested too deeply");
+}
+
+TEST(ParserTest, Lines) {
+  Parser parser;
+  std::vector<ParseError> errors;
+  std::vector<std::shared_ptr<Expression>> result =
+      parser.parseLines("x + 1\n2 *\ny ^ 2", errors);
+  ASSERT_EQ(result.size(), 3);
+  EXPECT_EQ(result[0]->toStringStream().str(), "(x + 1)");
+  EXPECT_EQ(result[1], nullptr);
+  EXPECT_EQ(result[2]->toStringStream().str(), "(y ^ 2)");
+  ASSERT_EQ(errors.size(), 1);
+  EXPECT_EQ(errors[0].position, 9);
+}
+
+TEST(ParserTest, Arena) {
+  Parser parser;
+  ExpressionArena arena;
+  ParseError error;
+  ExpressionArena::Id id = parser.parse("x * y + x * y", arena, error);
+  ASSERT_FALSE(error);
+  EXPECT_EQ(arena.toString(id), "((x * y) + (x * y))");
+  EXPECT_EQ(arena[id].left, arena[id].right);
+}
+
+TEST(ParserTest, Ln) {
+  Parser parser;
+  ParseError error;
+  std::shared_ptr<Expression> e = parser.parse("ln(x + 1) * ln", error);
+  ASSERT_FALSE(error);
+  EXPECT_EQ(e->toStringStream().str(), "(ln((x + 1)) * ln)");
+  EXPECT_FALSE(parser.parse("ln(x", error));
+  EXPECT_STREQ(error.message, "Expected ')'");
+}
+
+TEST(ParserTest, IntMin) {
+  Parser parser;
+  ParseError error;
+  std::shared_ptr<Expression> e = parser.parse("-2147483648", error);
+  ASSERT_NE(e, nullptr);
+  ASSERT_EQ(e->getKind(), Expression::Kind::Val);
+  EXPECT_EQ(static_cast<const Val &>(*e).getValue(), INT_MIN);
+  EXPECT_EQ(parser.parse("x * - 2147483648", error)->toStringStream().str(),
+            "(x * -2147483648)");
+  EXPECT_EQ(parser.parse("--2147483648", error)->toStringStream().str(),
+            "(-1 * -2147483648)");
+}
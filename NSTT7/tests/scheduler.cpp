@@ -0,0 +1,72 @@
+#include "../src/scheduler.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+// Sum over i of (x * i + y) ^ 2 / (i + z): wide levels of independent nodes.
+std::shared_ptr<Expression> wideSample(int terms) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> y = std::make_shared<Var>("y");
+  std::shared_ptr<Expression> z = std::make_shared<Var>("z");
+  std::shared_ptr<Expression> sum = std::make_shared<Val>(0);
+  for (int i = 1; i <= terms; ++i) {
+    std::shared_ptr<Expression> c = std::make_shared<Val>(i);
+    std::shared_ptr<Expression> term = std::make_shared<Div>(
+        std::make_shared<Exponent>(
+            std::make_shared<Add>(std::make_shared<Mult>(x, c), y),
+            std::make_shared<Val>(2)),
+        std::make_shared<Add>(c, z));
+    sum = std::make_shared<Add>(sum, term);
+  }
+  return sum;
+}
+
+} // namespace
+
+TEST(ThreadPoolTest, CoversRange) {
+  ThreadPool pool(4);
+  std::vector<std::atomic<int>> hits(10000);
+  for (int round = 0; round < 20; ++round) {
+    pool.parallelFor(hits.size(), 16, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        ++hits[i];
+      }
+    });
+  }
+  for (const std::atomic<int> &hit : hits) {
+    ASSERT_EQ(hit, 20);
+  }
+}
+
+TEST(ParallelEvaluatorTest, Point) {
+  ThreadPool pool(4);
+  std::shared_ptr<Expression> e = wideSample(200);
+  Tape tape(e, {"x", "y", "z"});
+  ParallelEvaluator parallel({e}, {"x", "y", "z"}, pool, 8);
+  EXPECT_GT(parallel.getLevelCount(), 1);
+  std::vector<double> point{0.5, -1.5, 2};
+  EXPECT_DOUBLE_EQ(parallel.evaluate(point)[0], tape.evaluate(point)[0]);
+  EXPECT_THROW(parallel.evaluate({1, 2}), std::invalid_argument);
+}
+
+TEST(ParallelEvaluatorTest, Batch) {
+  ThreadPool pool(3);
+  std::shared_ptr<Expression> e = wideSample(20);
+  std::shared_ptr<Expression> f =
+      std::make_shared<Ln>(std::make_shared<Var>("z"));
+  Tape tape({e, f}, {"x", "y", "z"});
+  ParallelEvaluator parallel({e, f}, {"x", "y", "z"}, pool, 1);
+  size_t count = 5 * Tape::kBlock + 17;
+  std::vector<double> x(count), y(count), z(count);
+  for (size_t k = 0; k < count; ++k) {
+    x[k] = 0.01 * k;
+    y[k] = 1 - 0.02 * k;
+    z[k] = 1 + 0.5 * k;
+  }
+  std::vector<double> e1(count), f1(count), e2(count), f2(count);
+  tape.evaluate({x.data(), y.data(), z.data()}, count, {e1.data(), f1.data()});
+  parallel.evaluate({x.data(), y.data(), z.data()}, count,
+                    {e2.data(), f2.data()});
+  EXPECT_EQ(e1, e2);
+  EXPECT_EQ(f1, f2);
+}
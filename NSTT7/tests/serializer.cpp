@@ -0,0 +1,52 @@
+#include "../src/serializer.h"
+#include <gtest/gtest.h>
+#include <iterator>
+
+TEST(SerializerTest, String) {
+  std::shared_ptr<Expression> e = std::make_shared<Sub>(
+      std::make_shared<Var>("x"),
+      std::make_shared<Mult>(std::make_shared<Val>(-12),
+                             std::make_shared<Var>("y")));
+  std::string out = "e = ";
+  writeTo(*e, out);
+  EXPECT_EQ(out, "e = (x - (-12 * y))");
+}
+
+TEST(SerializerTest, Stream) {
+  std::shared_ptr<Expression> e = std::make_shared<Exponent>(
+      std::make_shared<Var>("x"), std::make_shared<Val>(2));
+  std::stringstream ss;
+  ss << *e << ';';
+  EXPECT_EQ(ss.str(), "(x ^ 2);");
+}
+
+TEST(SerializerTest, DeepTree) {
+  std::shared_ptr<Expression> e = std::make_shared<Var>("x");
+  size_t depth = 200000;
+  for (size_t i = 0; i < depth; ++i) {
+    e = std::make_shared<Add>(e, std::make_shared<Val>(1));
+  }
+  std::string out;
+  writeTo(*e, out);
+  EXPECT_EQ(out.size(), 1 + depth * 6);
+  EXPECT_EQ(out.find("x + 1) + 1)"), depth);
+  EXPECT_TRUE(out.ends_with(" + 1) + 1)"));
+
+  // Tear the chain down iteratively, the recursive destructor of a tree
+  // this deep would overflow the stack.
+  while (e->isBinary()) {
+    e = static_cast<const Binary &>(*e).getLeft();
+  }
+}
+
+TEST(SerializerTest, SharedSubexpressions) {
+  std::shared_ptr<Expression> s = std::make_shared<Add>(
+      std::make_shared<Var>("x"), std::make_shared<Var>("y"));
+  std::shared_ptr<Expression> t = std::make_shared<Mult>(s, s);
+  std::shared_ptr<Expression> e = std::make_shared<Div>(t, t);
+  std::string out;
+  writeSharedTo(*e, out);
+  EXPECT_EQ(out, "(#1=(#2=(x + y) * #2) / #1)");
+  EXPECT_EQ(e->toStringStream().str(),
+            "(((x + y) * (x + y)) / ((x + y) * (x + y)))");
+}
@@ -0,0 +1,98 @@
+#include "../src/simplifier.h"
+#include <gtest/gtest.h>
+
+TEST(SimplifyTest, ConstantFolding) {
+  std::shared_ptr<Expression> e = std::make_shared<Add>(
+      std::make_shared<Mult>(std::make_shared<Val>(2),
+                             std::make_shared<Val>(3)),
+      std::make_shared<Exponent>(std::make_shared<Val>(2),
+                                 std::make_shared<Val>(4)));
+  EXPECT_EQ(simplify(e)->toStringStream().str(), "22");
+}
+
+TEST(SimplifyTest, IdentityAndZero) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> y = std::make_shared<Var>("y");
+  std::shared_ptr<Expression> e = std::make_shared<Add>(
+      std::make_shared<Mult>(x, std::make_shared<Val>(0)),
+      std::make_shared<Mult>(std::make_shared<Val>(1),
+                             std::make_shared<Add>(std::make_shared<Val>(0),
+                                                   y)));
+  EXPECT_EQ(simplify(e)->toStringStream().str(), "y");
+
+  std::shared_ptr<Expression> p =
+      std::make_shared<Exponent>(x, std::make_shared<Val>(1));
+  EXPECT_EQ(simplify(p)->toStringStream().str(), "x");
+}
+
+TEST(SimplifyTest, LikeTerms) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> e = std::make_shared<Add>(
+      std::make_shared<Mult>(x, std::make_shared<Val>(3)),
+      std::make_shared<Mult>(std::make_shared<Val>(2), x));
+  EXPECT_EQ(simplify(e)->toStringStream().str(), "(5 * x)");
+
+  std::shared_ptr<Expression> two_x =
+      std::make_shared<Mult>(std::make_shared<Val>(2), x);
+  std::shared_ptr<Expression> f =
+      std::make_shared<Sub>(std::make_shared<Add>(x, x), two_x);
+  EXPECT_EQ(simplify(f)->toStringStream().str(), "0");
+
+  std::shared_ptr<Expression> g =
+      std::make_shared<Mult>(std::make_shared<Mult>(x, x), x);
+  EXPECT_EQ(simplify(g)->toStringStream().str(), "(x ^ 3)");
+}
+
+TEST(SimplifyTest, DeepTree) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> e = x;
+  size_t depth = 200000;
+  for (size_t i = 0; i < depth; ++i) {
+    if (i % 2) {
+      e = std::make_shared<Mult>(e, std::make_shared<Val>(1));
+    } else {
+      e = std::make_shared<Add>(e, std::make_shared<Val>(0));
+    }
+  }
+  EXPECT_EQ(simplify(e)->toStringStream().str(), "x");
+
+  // Tear the chain down iteratively, the recursive destructor of a tree
+  // this deep would overflow the stack.
+  while (e->isBinary()) {
+    e = static_cast<const Binary &>(*e).getLeft();
+  }
+}
+
+TEST(SimplifyTest, Interning) {
+  Simplifier s;
+  std::shared_ptr<Expression> a = std::make_shared<Add>(
+      std::make_shared<Var>("x"), std::make_shared<Var>("y"));
+  std::shared_ptr<Expression> b = std::make_shared<Add>(
+      std::make_shared<Var>("x"), std::make_shared<Var>("y"));
+  EXPECT_EQ(s.simplify(a), s.simplify(b));
+  EXPECT_EQ(s.simplify(s.simplify(a)), s.simplify(a));
+}
+
+TEST(SimplifyTest, DiffWithSimplifier) {
+  Simplifier s;
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> c =
+      std::make_shared<Mult>(x, std::make_shared<Val>(3));
+  EXPECT_EQ(c->diff("x", &s)->toStringStream().str(), "3");
+
+  std::shared_ptr<Expression> p =
+      std::make_shared<Exponent>(x, std::make_shared<Val>(3));
+  EXPECT_EQ(p->diff("x", &s)->toStringStream().str(), "(3 * (x ^ 2))");
+
+  std::shared_ptr<Expression> d = std::make_shared<Div>(
+      std::make_shared<Val>(4), std::make_shared<Var>("y"));
+  EXPECT_EQ(d->diff("y", &s)->toStringStream().str(), "(-4 / (y ^ 2))");
+}
+
+TEST(SimplifyTest, DiffSub) {
+  Simplifier s;
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> e = std::make_shared<Sub>(
+      std::make_shared<Mult>(std::make_shared<Val>(5), x), x);
+  EXPECT_EQ(e->diff("x", &s)->toStringStream().str(), "4");
+}
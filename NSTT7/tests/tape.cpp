@@ -0,0 +1,71 @@
+#include "../src/tape.h"
+#include <gtest/gtest.h>
+
+TEST(TapeTest, EvaluatePoint) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> y = std::make_shared<Var>("y");
+  std::shared_ptr<Expression> e = std::make_shared<Div>(
+      std::make_shared<Add>(std::make_shared<Exponent>(
+                                x, std::make_shared<Val>(2)),
+                            y),
+      std::make_shared<Sub>(y, std::make_shared<Val>(1)));
+  Tape tape(e, {"x", "y"});
+  EXPECT_DOUBLE_EQ(tape.evaluate({3, 5})[0], 3.5);
+}
+
+TEST(TapeTest, CommonSubexpressions) {
+  // (x + y) * (y + x) compiles to two inputs, one addition and one product.
+  std::shared_ptr<Expression> e = std::make_shared<Mult>(
+      std::make_shared<Add>(std::make_shared<Var>("x"),
+                            std::make_shared<Var>("y")),
+      std::make_shared<Add>(std::make_shared<Var>("y"),
+                            std::make_shared<Var>("x")));
+  Tape tape(e, {"x", "y"});
+  EXPECT_EQ(tape.getInstructions().size(), 4);
+  EXPECT_EQ(tape.getRegisterCount(), 2);
+  EXPECT_DOUBLE_EQ(tape.evaluate({1, 2})[0], 9);
+}
+
+TEST(TapeTest, UnknownVariable) {
+  std::shared_ptr<Expression> e = std::make_shared<Var>("z");
+  EXPECT_THROW(Tape(e, {"x"}), std::invalid_argument);
+}
+
+TEST(TapeTest, EvaluateColumns) {
+  std::shared_ptr<Expression> x = std::make_shared<Var>("x");
+  std::shared_ptr<Expression> y = std::make_shared<Var>("y");
+  std::shared_ptr<Expression> f =
+      std::make_shared<Sub>(std::make_shared<Mult>(x, y), x);
+  Tape tape({f, f->diff("x")}, {"x", "y"});
+
+  size_t count = 1000;
+  std::vector<double> xs(count), ys(count), values(count), derivatives(count);
+  for (size_t i = 0; i < count; ++i) {
+    xs[i] = i * 0.5;
+    ys[i] = 3.0 - i;
+  }
+  tape.evaluate({xs.data(), ys.data()}, count,
+                {values.data(), derivatives.data()});
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_DOUBLE_EQ(values[i], xs[i] * ys[i] - xs[i]);
+    EXPECT_DOUBLE_EQ(derivatives[i], ys[i] - 1);
+  }
+}
+
+TEST(TapeTest, DeepTree) {
+  std::shared_ptr<Expression> e = std::make_shared<Var>("x");
+  size_t depth = 200000;
+  for (size_t i = 0; i < depth; ++i) {
+    e = std::make_shared<Add>(e, std::make_shared<Val>(1));
+  }
+  Tape tape(e, {"x"});
+  EXPECT_EQ(tape.getInstructions().size(), depth + 2);
+  EXPECT_LE(tape.getRegisterCount(), 3);
+  EXPECT_DOUBLE_EQ(tape.evaluate({2})[0], depth + 2.0);
+
+  // Tear the chain down iteratively, the recursive destructor of a tree
+  // this deep would overflow the stack.
+  while (e->isBinary()) {
+    e = static_cast<const Binary &>(*e).getLeft();
+  }
+}
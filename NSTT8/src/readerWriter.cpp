@@ -1,8 +1,130 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <fcntl.h>
 #include <ios>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <stddef.h>
+#include <stdexcept>
 #include <string.h>
 #include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// How values are laid out in the buffer. Text is human readable and
+// whitespace separated. Binary packs integers as zigzag LEB128 varints,
+// floats as raw IEEE bytes in host order, chars and bools as single bytes
+// and strings with an unsigned varint length prefix; it has no delimiters,
+// so values must be read back in the order and with the types they were
+// written.
+enum class Encoding { text, binary };
+
+// Free buffers kept for reuse by the IO objects of one thread, so that
+// short-lived readers and writers do not go to malloc. Buffers are
+// grouped by power-of-two capacity. The pool is off, and IO allocates
+// exactly what it is asked for, until set_limit() is called.
+class BufferPool {
+  std::vector<char *> free_[std::numeric_limits<size_t>::digits + 1];
+  size_t limit_ = 0;
+
+  static size_t bucket(size_t capacity) { return std::bit_width(capacity); }
+
+  void trim() {
+    for (std::vector<char *> &buffers : free_) {
+      while (buffers.size() > limit_) {
+        delete[] buffers.back();
+        buffers.pop_back();
+      }
+    }
+  }
+
+public:
+  BufferPool() = default;
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  ~BufferPool() {
+    limit_ = 0;
+    trim();
+  }
+
+  // The pool of the calling thread.
+  static BufferPool &local() {
+    thread_local BufferPool pool;
+    return pool;
+  }
+
+  // Keeps at most `limit` free buffers of each capacity; 0 turns the pool
+  // off and frees what it holds.
+  void set_limit(size_t limit) {
+    limit_ = limit;
+    trim();
+  }
+
+  size_t size() const {
+    size_t total = 0;
+    for (const std::vector<char *> &buffers : free_) {
+      total += buffers.size();
+    }
+    return total;
+  }
+
+  // A buffer of at least `capacity` bytes; `capacity` is updated to its
+  // actual size, which is a power of two while the pool is on.
+  char *acquire(size_t &capacity) {
+    if (limit_ == 0) {
+      return new char[capacity];
+    }
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 64));
+    std::vector<char *> &buffers = free_[bucket(capacity)];
+    if (buffers.empty()) {
+      return new char[capacity];
+    }
+    char *buffer = buffers.back();
+    buffers.pop_back();
+    return buffer;
+  }
+
+  void release(char *buffer, size_t capacity) {
+    if (buffer == nullptr) {
+      return;
+    }
+    if (std::has_single_bit(capacity)) {
+      std::vector<char *> &buffers = free_[bucket(capacity)];
+      if (buffers.size() < limit_) {
+        buffers.push_back(buffer);
+        return;
+      }
+    }
+    delete[] buffer;
+  }
+};
 
 class IO {
 protected:
@@ -13,97 +135,285 @@ protected:
   void set_eof(bool eof) { eof_ = eof; };
   bool is_open_;
   bool eof_;
+  // False when `buffer` belongs to someone else, e.g. a file mapping.
+  bool owns_buffer_ = true;
+  Encoding encoding_ = Encoding::text;
 
-  void resize_buffer() {
-    char *new_buffer = new char[buffer_capacity_ *= 2];
-    memcpy(new_buffer, buffer, buffer_size_);
-    delete[] buffer;
-    buffer = new_buffer;
-  };
+  // Longest LEB128 encoding of a 64-bit value.
+  static constexpr size_t max_varint_size_ = 10;
+
+  static uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^
+           static_cast<uint64_t>(value >> 63);
+  }
+  static int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  static char *allocate(size_t &capacity) {
+    return BufferPool::local().acquire(capacity);
+  }
+  static void deallocate(char *buffer, size_t capacity) {
+    BufferPool::local().release(buffer, capacity);
+  }
+
+  // Grows the buffer to hold at least `required` bytes in one step. The
+  // capacity at least doubles, so repeated growth stays amortized O(1).
+  void resize_buffer(size_t required) {
+    reserve(std::max(required, 2 * buffer_capacity_));
+  }
+
+  // Works on `size` bytes of external memory, which is never freed.
+  IO(char *data, size_t size, Encoding encoding)
+      : buffer_size_(size), buffer_capacity_(size), buffer(data),
+        is_open_(true), eof_(false), owns_buffer_(false),
+        encoding_(encoding) {}
 
 public:
-  IO(size_t buffer_capacity = 1024)
+  IO(size_t buffer_capacity = 1024, Encoding encoding = Encoding::text)
       : buffer_capacity_(buffer_capacity), buffer_size_(0),
-        buffer(new char[buffer_capacity_]), eof_(false), is_open_(true) {}
+        buffer(allocate(buffer_capacity_)), eof_(false), is_open_(true),
+        encoding_(encoding) {}
 
-  virtual ~IO() { delete[] buffer; }
+  virtual ~IO() {
+    if (owns_buffer_) {
+      deallocate(buffer, buffer_capacity_);
+    }
+  }
   virtual void close() = 0;
 
   bool is_open() const { return is_open_; };
   bool get_eof() const { return eof_; };
+  Encoding encoding() const { return encoding_; }
+
+  std::string_view data() const { return {buffer, buffer_size_}; }
+  size_t capacity() const { return buffer_capacity_; }
+
+  // Grows the buffer to at least `capacity` bytes in a single allocation.
+  void reserve(size_t capacity) {
+    if (capacity <= buffer_capacity_) {
+      return;
+    }
+    char *new_buffer = allocate(capacity);
+    memcpy(new_buffer, buffer, buffer_size_);
+    if (owns_buffer_) {
+      deallocate(buffer, buffer_capacity_);
+    }
+    buffer = new_buffer;
+    buffer_capacity_ = capacity;
+    owns_buffer_ = true;
+  }
 };
 
 class Reader : public IO {
-public:
-  Reader(size_t buffer_capacity = 1024) : IO(buffer_capacity) {}
+  // Longest output of to_chars for any of the arithmetic overloads:
+  // "-1.2345678901234567e-308" is 24 characters.
+  static constexpr size_t max_number_size_ = 32;
 
-  void read(int value) {
+  void check_open() const {
     if (!is_open_) {
       throw std::ios_base::failure("Reader is not open");
     }
-    char buffer[11];
-    int size = snprintf(buffer, sizeof(buffer), "%d", value);
-    this->read(std::string(buffer, size));
-  };
+  }
 
-  void read(long value) {
-    if (!is_open_) {
-      throw std::ios_base::failure("Reader is not open");
+  // Makes room for `size` more characters and the terminating '\0'.
+  char *append(size_t size) {
+    if (buffer_size_ + size + 1 > buffer_capacity_) {
+      overflow(size);
     }
-    char buffer[21];
-    int size = snprintf(buffer, sizeof(buffer), "%ld", value);
-    this->read(std::string(buffer, size));
-  };
+    return buffer + buffer_size_;
+  }
 
-  void read(long long value) {
-    if (!is_open_) {
-      throw std::ios_base::failure("Reader is not open");
+  // Formats `value` at `out`, which has room for max_number_size_
+  // characters, and returns the end.
+  template <typename T> static char *put_number(char *out, T value) {
+    char *last = out + max_number_size_;
+    if constexpr (std::is_same_v<T, float>) {
+      // Same digits as printf's %.7g and %.17g.
+      return std::to_chars(out, last, value, std::chars_format::general, 7)
+          .ptr;
+    } else if constexpr (std::is_same_v<T, double>) {
+      return std::to_chars(out, last, value, std::chars_format::general, 17)
+          .ptr;
+    } else {
+      return std::to_chars(out, last, value).ptr;
     }
-    char buffer[21];
-    int size = snprintf(buffer, sizeof(buffer), "%lld", value);
-    this->read(std::string(buffer, size));
   }
-  void read(float value) {
-    if (!is_open_) {
-      throw std::ios_base::failure("Reader is not open");
+
+  // Formats straight into the buffer, without an intermediate string.
+  template <typename T> void format(T value) {
+    buffer_size_ = put_number(append(max_number_size_), value) - buffer;
+    buffer[buffer_size_] = '\0';
+  }
+
+  static char *put_varint(char *out, uint64_t value) {
+    while (value >= 0x80) {
+      *out++ = static_cast<char>(value | 0x80);
+      value >>= 7;
     }
-    char buffer[24];
-    int size = snprintf(buffer, sizeof(buffer), "%.7g", value);
-    this->read(std::string(buffer, size));
+    *out++ = static_cast<char>(value);
+    return out;
   }
-  void read(double value) {
-    if (!is_open_) {
-      throw std::ios_base::failure("Reader is not open");
+
+  // Zigzag varints for `count` ints. With SSE2, runs of eight values that
+  // all fit into one byte are narrowed and stored together.
+  static char *put_varints(char *out, const int *values, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i high = _mm_set1_epi32(~0x7f);
+    for (; i + 8 <= count; i += 8) {
+      const __m128i *block = reinterpret_cast<const __m128i *>(values + i);
+      __m128i a = _mm_loadu_si128(block);
+      __m128i b = _mm_loadu_si128(block + 1);
+      a = _mm_xor_si128(_mm_slli_epi32(a, 1), _mm_srai_epi32(a, 31));
+      b = _mm_xor_si128(_mm_slli_epi32(b, 1), _mm_srai_epi32(b, 31));
+      __m128i big = _mm_and_si128(_mm_or_si128(a, b), high);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(big, zero)) != 0xFFFF) {
+        for (size_t j = i; j < i + 8; ++j) {
+          out = put_varint(out, zigzag(values[j]));
+        }
+        continue;
+      }
+      __m128i words = _mm_packs_epi32(a, b);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(out),
+                       _mm_packus_epi16(words, words));
+      out += 8;
+    }
+#endif
+    for (; i < count; ++i) {
+      out = put_varint(out, zigzag(values[i]));
     }
-    char buffer[40];
-    int size = snprintf(buffer, sizeof(buffer), "%.17g", value);
-    this->read(std::string(buffer, size));
+    return out;
   }
-  void read(char value) {
-    if (!is_open_) {
-      throw std::ios_base::failure("Reader is not open");
+
+  template <typename T> void encode(T value) {
+    char *out = append(max_varint_size_);
+    if constexpr (std::is_floating_point_v<T>) {
+      memcpy(out, &value, sizeof(T));
+      out += sizeof(T);
+    } else {
+      out = put_varint(out, zigzag(value));
+    }
+    buffer_size_ = out - buffer;
+    buffer[buffer_size_] = '\0';
+  }
+
+  template <typename T> void number(T value) {
+    check_open();
+    if (encoding_ == Encoding::binary) {
+      encode(value);
+    } else {
+      format(value);
+    }
+  }
+
+  void put_byte(char value) {
+    check_open();
+    *append(1) = value;
+    buffer[++buffer_size_] = '\0';
+  }
+
+  void put_bytes(const char *data, size_t size) {
+    memcpy(append(size), data, size);
+    buffer_size_ += size;
+    buffer[buffer_size_] = '\0';
+  }
+
+  // Values of at most `width` characters handled per append() by the bulk
+  // read: as many as fit into the buffer, so that file and stream readers
+  // keep their buffer size.
+  size_t batch_size(size_t width) const {
+    return std::max<size_t>(1, (buffer_capacity_ - 1) / width);
+  }
+
+protected:
+  // Called when `size` more characters do not fit. The default grows the
+  // buffer; FileReader writes it out first and calls this only to grow it
+  // when the value still does not fit.
+  virtual void overflow(size_t size) {
+    if (buffer_size_ + size + 1 > buffer_capacity_) {
+      resize_buffer(buffer_size_ + size + 1);
     }
-    char buffer[2];
-    buffer[0] = value;
-    buffer[1] = '\0';
-    this->read(std::string(buffer));
   }
+
+public:
+  Reader(size_t buffer_capacity = 1024, Encoding encoding = Encoding::text)
+      : IO(buffer_capacity, encoding) {}
+
+  void read(int value) { number(value); };
+  void read(long value) { number(value); };
+  void read(long long value) { number(value); }
+  void read(float value) { number(value); }
+  void read(double value) { number(value); }
+  void read(char value) { put_byte(value); }
   void read(bool value) {
-    if (!is_open_) {
-      throw std::ios_base::failure("Reader is not open");
+    if (encoding_ == Encoding::binary) {
+      put_byte(value);
+    } else {
+      read(value ? std::string_view("true") : std::string_view("false"));
     }
-    this->read(value ? "true" : "false");
   }
-  void read(const std::string &value) {
-    if (!is_open_) {
-      throw std::ios_base::failure("Reader is not open");
+  void read(const char *value) { read(std::string_view(value)); }
+  void read(const std::string &value) { read(std::string_view(value)); }
+  void read(std::span<const char> value) {
+    read(std::string_view(value.data(), value.size()));
+  }
+  void read(std::string_view value) {
+    check_open();
+    if (encoding_ == Encoding::binary) {
+      // Lengths are never negative, so they skip the zigzag step.
+      char *out = append(max_varint_size_);
+      buffer_size_ = put_varint(out, value.size()) - buffer;
     }
-    if (value.size() + 2 > buffer_capacity_) {
-      resize_buffer();
+    put_bytes(value.data(), value.size());
+  }
+
+  // Appends every value. In text each one is followed by `delimiter`; in
+  // binary they are packed back to back without any framing. The state is
+  // checked once and room is made once per batch, so the inner loops only
+  // convert.
+  template <typename T>
+  void read(std::span<const T> values, char delimiter = ' ') {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, char> &&
+                      !std::is_same_v<T, bool>,
+                  "use read(std::string_view) for characters");
+    check_open();
+    if (encoding_ == Encoding::text) {
+      for (size_t i = 0, count; i < values.size(); i += count) {
+        count = std::min(batch_size(max_number_size_ + 1), values.size() - i);
+        char *out = append(count * (max_number_size_ + 1));
+        for (T value : values.subspan(i, count)) {
+          out = put_number(out, value);
+          *out++ = delimiter;
+        }
+        buffer_size_ = out - buffer;
+        buffer[buffer_size_] = '\0';
+      }
+    } else if constexpr (std::is_floating_point_v<T>) {
+      for (size_t i = 0, count; i < values.size(); i += count) {
+        count = std::min(batch_size(sizeof(T)), values.size() - i);
+        put_bytes(reinterpret_cast<const char *>(values.data() + i),
+                  count * sizeof(T));
+      }
+    } else if constexpr (std::is_same_v<T, int>) {
+      for (size_t i = 0, count; i < values.size(); i += count) {
+        count = std::min(batch_size(max_varint_size_), values.size() - i);
+        char *out = append(count * max_varint_size_);
+        buffer_size_ = put_varints(out, values.data() + i, count) - buffer;
+        buffer[buffer_size_] = '\0';
+      }
+    } else {
+      for (size_t i = 0, count; i < values.size(); i += count) {
+        count = std::min(batch_size(max_varint_size_), values.size() - i);
+        char *out = append(count * max_varint_size_);
+        for (T value : values.subspan(i, count)) {
+          out = put_varint(out, zigzag(value));
+        }
+        buffer_size_ = out - buffer;
+        buffer[buffer_size_] = '\0';
+      }
     }
-    memcpy(buffer + buffer_size_, value.c_str(), value.size());
-    buffer_size_ += value.size();
-    buffer[buffer_size_] = '\0';
   }
 
   void close() override {
@@ -111,108 +421,1142 @@ public:
     set_eof(true);
     buffer_size_ = 0;
   }
+};
+
+// Outcome of Writer::next. On any error the caret stays where it was, so
+// a token that fails to parse as one type can still be read as another.
+enum class ParseResult { ok, closed, end_of_input, invalid, out_of_range };
+
+template <typename T> struct Parsed {
+  T value{};
+  ParseResult result = ParseResult::ok;
 
-  ~Reader() { delete[] buffer; }
+  explicit operator bool() const { return result == ParseResult::ok; }
 };
 
 class Writer : public IO {
 protected:
   size_t caret_pos = 0;
 
+  // Token boundaries from index_tokens(): token k is
+  // [token_bounds_[2k], token_bounds_[2k + 1]).
+  std::vector<size_t> token_bounds_;
+  size_t token_cursor_ = 0;
+  bool indexed_ = false;
+
+  static bool is_delimiter(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+  }
+
+  // Bit i is set when p[i] is a delimiter, for the 64 bytes at p.
+  static uint64_t delimiter_mask(const char *p) {
+#if defined(__AVX2__)
+    uint64_t mask = 0;
+    for (int half = 0; half < 2; ++half) {
+      __m256i v = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(p + half * 32));
+      __m256i hit = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')),
+                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+      mask |= static_cast<uint64_t>(
+                  static_cast<uint32_t>(_mm256_movemask_epi8(hit)))
+              << (half * 32);
+    }
+    return mask;
+#elif defined(__SSE2__)
+    uint64_t mask = 0;
+    for (int quarter = 0; quarter < 4; ++quarter) {
+      __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(p + quarter * 16));
+      __m128i hit = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                       _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+          _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+                       _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+      mask |= static_cast<uint64_t>(_mm_movemask_epi8(hit)) << (quarter * 16);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; ++i) {
+      mask |= static_cast<uint64_t>(is_delimiter(p[i])) << i;
+    }
+    return mask;
+#endif
+  }
+
+  // First position in [from, buffer_size_) that is (or, with `want` false,
+  // is not) a delimiter; buffer_size_ if there is none.
+  size_t scan(size_t from, bool want) const {
+    size_t i = from;
+    for (; i + 64 <= buffer_size_; i += 64) {
+      uint64_t mask = delimiter_mask(buffer + i);
+      if (!want) {
+        mask = ~mask;
+      }
+      if (mask != 0) {
+        return i + __builtin_ctzll(mask);
+      }
+    }
+    while (i < buffer_size_ && is_delimiter(buffer[i]) != want) {
+      ++i;
+    }
+    return i;
+  }
+
+  // Moves the caret to the next token; eof is set once none is left.
+  void skip_delimiters() {
+    if (encoding_ == Encoding::binary) {
+      while (caret_pos == buffer_size_ && underflow()) {
+      }
+      set_eof(caret_pos == buffer_size_);
+      return;
+    }
+    caret_pos = scan(caret_pos, false);
+    while (caret_pos == buffer_size_ && underflow()) {
+      caret_pos = scan(caret_pos, false);
+    }
+    set_eof(caret_pos == buffer_size_);
+  }
+
+  // Called when the caret or the token under it reaches the end of the
+  // buffered data. Streaming writers fetch more data, possibly moving what
+  // is left to the front of the buffer (caret_pos is updated accordingly),
+  // and return false once the stream is over.
+  virtual bool underflow() { return false; }
+
+  // True when underflow() may append to the token at the end of the buffer,
+  // so that token cannot be indexed yet.
+  virtual bool streaming() const { return false; }
+
+  // The token under the caret is [caret_pos, end).
+  size_t token_end() {
+    if (indexed_) {
+      return token_bounds_[2 * token_cursor_ + 1];
+    }
+    size_t end = scan(caret_pos, true);
+    while (end == buffer_size_) {
+      size_t length = end - caret_pos;
+      if (!underflow()) {
+        break;
+      }
+      end = scan(caret_pos + length, true);
+    }
+    return end;
+  }
+
+  void advance(size_t end) {
+    if (indexed_) {
+      ++token_cursor_;
+      if (2 * token_cursor_ < token_bounds_.size()) {
+        caret_pos = token_bounds_[2 * token_cursor_];
+        return;
+      }
+      // Past the index; a stream may still have more, starting with a
+      // token that was left unindexed because it was still arriving.
+      indexed_ = false;
+    }
+    caret_pos = end;
+    skip_delimiters();
+  }
+
+  // Makes `size` bytes after the caret available, fetching more data from
+  // a stream if needed. False if the input ends first.
+  bool available(size_t size) {
+    while (buffer_size_ - caret_pos < size) {
+      if (!underflow()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Decodes the varint at the caret without consuming it.
+  ParseResult get_varint(uint64_t &value, size_t &size) {
+    value = 0;
+    for (size = 0; size < max_varint_size_; ++size) {
+      if (!available(size + 1)) {
+        return ParseResult::end_of_input;
+      }
+      uint8_t byte = buffer[caret_pos + size];
+      value |= static_cast<uint64_t>(byte & 0x7f) << (7 * size);
+      if ((byte & 0x80) == 0) {
+        ++size;
+        return ParseResult::ok;
+      }
+    }
+    return ParseResult::invalid;
+  }
+
+  void consume(size_t size) {
+    caret_pos += size;
+    skip_delimiters();
+  }
+
+  template <typename T> ParseResult decode(T &value) {
+    if constexpr (std::is_floating_point_v<T> || sizeof(T) == 1) {
+      if (!available(sizeof(T))) {
+        return ParseResult::end_of_input;
+      }
+      memcpy(&value, buffer + caret_pos, sizeof(T));
+      consume(sizeof(T));
+    } else {
+      uint64_t raw;
+      size_t size;
+      if (ParseResult result = get_varint(raw, size);
+          result != ParseResult::ok) {
+        return result;
+      }
+      int64_t decoded = unzigzag(raw);
+      if (std::is_unsigned_v<T> ? decoded < 0 ||
+                                      static_cast<uint64_t>(decoded) >
+                                          std::numeric_limits<T>::max()
+                                : decoded < std::numeric_limits<T>::min() ||
+                                      decoded > std::numeric_limits<T>::max()) {
+        return ParseResult::out_of_range;
+      }
+      value = static_cast<T>(decoded);
+      consume(size);
+    }
+    return ParseResult::ok;
+  }
+
+  // Decodes up to `count` ints. With SSE2, sixteen one-byte varints in a
+  // row are widened and unzigzagged together.
+  size_t get_varints(int *values, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+#if defined(__SSE2__)
+      if (count - done >= 16 && buffer_size_ - caret_pos >= 16) {
+        __m128i bytes = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(buffer + caret_pos));
+        if (_mm_movemask_epi8(bytes) == 0) {
+          const __m128i zero = _mm_setzero_si128();
+          const __m128i one = _mm_set1_epi32(1);
+          __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero),
+                              _mm_unpackhi_epi8(bytes, zero)};
+          for (int k = 0; k < 4; ++k) {
+            __m128i z = k % 2 == 0 ? _mm_unpacklo_epi16(words[k / 2], zero)
+                                   : _mm_unpackhi_epi16(words[k / 2], zero);
+            z = _mm_xor_si128(_mm_srli_epi32(z, 1),
+                              _mm_sub_epi32(zero, _mm_and_si128(z, one)));
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(values + done + 4 * k), z);
+          }
+          caret_pos += 16;
+          done += 16;
+          continue;
+        }
+      }
+#endif
+      if (decode(values[done]) != ParseResult::ok) {
+        break;
+      }
+      ++done;
+    }
+    skip_delimiters();
+    return done;
+  }
+
+  // Parses the text token under the caret; the state must be checked.
+  template <typename T> ParseResult parse(T &value) {
+    size_t end = token_end();
+    if constexpr (std::is_same_v<T, char>) {
+      if (end - caret_pos != 1) {
+        return ParseResult::invalid;
+      }
+      value = buffer[caret_pos];
+      advance(end);
+      return ParseResult::ok;
+    }
+    const char *last = buffer + end;
+    auto [ptr, ec] = std::from_chars(buffer + caret_pos, last, value);
+    if (ec == std::errc::invalid_argument || ptr != last) {
+      return ParseResult::invalid;
+    }
+    if (ec == std::errc::result_out_of_range) {
+      return ParseResult::out_of_range;
+    }
+    advance(end);
+    return ParseResult::ok;
+  }
+
+  // Copies as many raw floating point values as are buffered at a time.
+  template <typename T> size_t get_raw(T *values, size_t count) {
+    size_t done = 0;
+    while (done < count && available(sizeof(T))) {
+      size_t ready =
+          std::min(count - done, (buffer_size_ - caret_pos) / sizeof(T));
+      memcpy(values + done, buffer + caret_pos, ready * sizeof(T));
+      caret_pos += ready * sizeof(T);
+      done += ready;
+    }
+    skip_delimiters();
+    return done;
+  }
+
+  ParseResult check_state() {
+    if (!is_open_) {
+      return ParseResult::closed;
+    }
+    // Streams start out empty and look for their first token lazily.
+    if (!eof_ && caret_pos == buffer_size_) {
+      skip_delimiters();
+    }
+    return eof_ ? ParseResult::end_of_input : ParseResult::ok;
+  }
+
+  template <typename T> T next_or_throw() {
+    Parsed<T> parsed = next<T>();
+    switch (parsed.result) {
+    case ParseResult::ok:
+      return parsed.value;
+    case ParseResult::closed:
+      throw std::ios_base::failure("Writer is not open");
+    case ParseResult::end_of_input:
+      throw std::ios_base::failure("Nothing to write");
+    case ParseResult::out_of_range:
+      throw std::out_of_range("Number out of range");
+    default:
+      throw std::invalid_argument("Not a number");
+    }
+  }
+
+  // Parses external memory in place without copying it.
+  Writer(const char *data, size_t size, Encoding encoding)
+      : IO(const_cast<char *>(data), size, encoding) {
+    skip_delimiters();
+  }
+
 public:
-  Writer(size_t buffer_capacity, const char *buffer_) : IO(buffer_capacity) {
-    if (buffer != nullptr) {
-      memcpy(buffer, buffer_, buffer_size_);
+  // Takes ownership of `buffer_`, which holds `buffer_size` characters.
+  Writer(size_t buffer_size, const char *buffer_,
+         Encoding encoding = Encoding::text)
+      : IO(buffer_size, encoding) {
+    if (buffer_ != nullptr) {
+      memcpy(buffer, buffer_, buffer_size);
+      buffer_size_ = buffer_size;
       delete[] buffer_;
     }
+    skip_delimiters();
   }
 
-  const std::string &get_buffer() const {
+  explicit Writer(std::string_view text, Encoding encoding = Encoding::text)
+      : IO(text.size(), encoding) {
+    memcpy(buffer, text.data(), text.size());
+    buffer_size_ = text.size();
+    skip_delimiters();
+  }
+
+  std::string get_buffer() const {
     return std::string(buffer, buffer_size_);
   };
 
-  int write_int() {
-    if (!is_open_) {
-      throw std::ios_base::failure("Writer is not open");
+  // Parses the next whitespace separated token in place with from_chars.
+  // The whole token must be a number of type T, or a single character for
+  // char. In binary the next value is decoded instead.
+  template <typename T> ParseResult next(T &value) {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+                  "next<T> parses numbers only");
+    if (ParseResult state = check_state(); state != ParseResult::ok) {
+      return state;
     }
-    if (eof_) {
-      throw std::ios_base::failure("Nothing to write");
+    if (encoding_ == Encoding::binary) {
+      return decode(value);
+    }
+    return parse(value);
+  }
+
+  // The next token as is, or a length-prefixed string in binary. It points
+  // into the buffer and stays valid until the next call.
+  ParseResult next(std::string_view &token) {
+    if (ParseResult state = check_state(); state != ParseResult::ok) {
+      return state;
     }
-    long long value = write_long_long();
-    if (value > std::numeric_limits<int>::max() ||
-        value < std::numeric_limits<int>::min()) {
+    if (encoding_ == Encoding::binary) {
+      uint64_t raw;
+      size_t prefix;
+      if (ParseResult result = get_varint(raw, prefix);
+          result != ParseResult::ok) {
+        return result;
+      }
+      // A stream may still deliver the rest; anything else must already
+      // hold the whole string.
+      size_t left = buffer_size_ - caret_pos - prefix;
+      if (raw > std::numeric_limits<size_t>::max() - prefix ||
+          (!streaming() && raw > left)) {
+        return ParseResult::invalid;
+      }
+      size_t size = raw;
+      if (!available(prefix + size)) {
+        return ParseResult::end_of_input;
+      }
+      token = std::string_view(buffer + caret_pos + prefix, size);
+      consume(prefix + size);
+      return ParseResult::ok;
     }
-    return static_cast<int>(value);
+    size_t end = token_end();
+    token = std::string_view(buffer + caret_pos, end - caret_pos);
+    advance(end);
+    return ParseResult::ok;
   }
-  long write_long() {
-    if (!is_open_) {
-      throw std::ios_base::failure("Writer is not open");
+
+  // "true" or "false" in text, one byte in binary.
+  ParseResult next(bool &value) {
+    if (encoding_ == Encoding::binary) {
+      char byte;
+      ParseResult result = next(byte);
+      value = byte != 0;
+      return result;
     }
-    if (eof_) {
-      throw std::ios_base::failure("Nothing to write");
+    if (ParseResult state = check_state(); state != ParseResult::ok) {
+      return state;
     }
-    if (caret_pos + 21 > buffer_size_) {
-      set_eof(true);
-      char tmp[buffer_size_ - caret_pos + 1];
-      memcpy(tmp, buffer + caret_pos, buffer_size_ - caret_pos);
-      tmp[buffer_size_ - caret_pos] = '\0';
+    size_t end = token_end();
+    std::string_view token(buffer + caret_pos, end - caret_pos);
+    if (token != "true" && token != "false") {
+      return ParseResult::invalid;
+    }
+    value = token == "true";
+    advance(end);
+    return ParseResult::ok;
+  }
+
+  // Reads consecutive values into `values` and returns how many were read;
+  // fewer than requested when next would have failed. The state is checked
+  // once for the whole span.
+  template <typename T> size_t next_n(std::span<T> values) {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+                  "next_n parses numbers only");
+    if (check_state() != ParseResult::ok) {
+      return 0;
+    }
+    size_t done = 0;
+    if (encoding_ == Encoding::text) {
+      while (done < values.size() && !eof_ &&
+             parse(values[done]) == ParseResult::ok) {
+        ++done;
+      }
+    } else if constexpr (std::is_floating_point_v<T>) {
+      done = get_raw(values.data(), values.size());
+    } else if constexpr (std::is_same_v<T, int>) {
+      done = get_varints(values.data(), values.size());
     } else {
-      char tmp[21];
-      memcpy(tmp, buffer + caret_pos, 20);
-      tmp[20] = '\0';
-      caret_pos += 21;
-      return std::stoll(tmp);
+      while (done < values.size() && !eof_ &&
+             decode(values[done]) == ParseResult::ok) {
+        ++done;
+      }
+    }
+    return done;
+  }
+
+  template <typename T> Parsed<T> next() {
+    Parsed<T> parsed;
+    parsed.result = next(parsed.value);
+    return parsed;
+  }
+
+  int write_int() { return next_or_throw<int>(); }
+  long write_long() { return next_or_throw<long>(); }
+  long long write_long_long() { return next_or_throw<long long>(); }
+
+  // Offset of the first delimiter at or after `from`, or the buffer size.
+  size_t find_delimiter(size_t from = 0) const { return scan(from, true); }
+
+  // Records the bounds of every token after the caret in one vectorized
+  // pass; later calls to next jump straight from token to token. Returns
+  // the number of tokens left. Text only.
+  size_t index_tokens() {
+    if (encoding_ == Encoding::binary) {
+      return 0;
+    }
+    token_bounds_.clear();
+    token_cursor_ = 0;
+    // Bit i of `inside` is set when byte i belongs to a token, so the bits
+    // of inside ^ (inside << 1) mark where tokens begin and end.
+    uint64_t carry = 0;
+    size_t i = caret_pos;
+    for (; i + 64 <= buffer_size_; i += 64) {
+      uint64_t inside = ~delimiter_mask(buffer + i);
+      uint64_t edges = inside ^ ((inside << 1) | carry);
+      carry = inside >> 63;
+      for (; edges != 0; edges &= edges - 1) {
+        token_bounds_.push_back(i + __builtin_ctzll(edges));
+      }
+    }
+    for (; i < buffer_size_; ++i) {
+      uint64_t inside = !is_delimiter(buffer[i]);
+      if (inside != carry) {
+        token_bounds_.push_back(i);
+      }
+      carry = inside;
+    }
+    if (carry) {
+      if (streaming()) {
+        // The last token may still be arriving; it is read without the
+        // index once the indexed ones are used up.
+        token_bounds_.pop_back();
+      } else {
+        token_bounds_.push_back(buffer_size_);
+      }
+    }
+    indexed_ = !token_bounds_.empty();
+    return token_bounds_.size() / 2;
+  }
+
+  void close() override {
+    is_open_ = false;
+    set_eof(true);
+  }
+};
+
+// Reader that streams into a file. Values are formatted into a fixed-size
+// buffer that is written out whenever it fills up and on close().
+class FileReader : public Reader {
+  int fd_;
+
+  void write_all(const char *data, size_t size) {
+    while (size > 0) {
+      ssize_t written = ::write(fd_, data, size);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::ios_base::failure("Cannot write file",
+                                     std::error_code(errno,
+                                                     std::generic_category()));
+      }
+      data += written;
+      size -= written;
+    }
+  }
+
+protected:
+  void overflow(size_t size) override {
+    flush();
+    // Only values longer than the whole buffer make it grow.
+    Reader::overflow(size);
+  }
+
+public:
+  explicit FileReader(const std::string &path, size_t buffer_capacity = 1 << 16,
+                      Encoding encoding = Encoding::text)
+      : Reader(buffer_capacity, encoding) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      throw std::ios_base::failure(
+          "Cannot open file", std::error_code(errno, std::generic_category()));
     }
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
   }
-  long long write_long_long() {
+
+  FileReader(const FileReader &) = delete;
+  FileReader &operator=(const FileReader &) = delete;
+
+  void flush() {
+    write_all(buffer, buffer_size_);
+    buffer_size_ = 0;
+  }
+
+  void close() override {
     if (!is_open_) {
-      throw std::ios_base::failure("Writer is not open");
+      return;
     }
-    if (eof_) {
-      throw std::ios_base::failure("Nothing to write");
+    flush();
+    Reader::close();
+    if (::close(fd_) != 0) {
+      throw std::ios_base::failure(
+          "Cannot close file", std::error_code(errno, std::generic_category()));
+    }
+  }
+
+  // Closing here cannot report errors; call close() to see them.
+  ~FileReader() {
+    if (is_open_) {
+      try {
+        flush();
+      } catch (const std::ios_base::failure &) {
+      }
+      ::close(fd_);
+    }
+  }
+};
+
+// Writer over a read-only memory mapping of a file. Tokens are parsed in
+// place, so nothing is copied, and the kernel is told that the file is read
+// sequentially so that it reads ahead and drops pages behind the caret.
+class FileWriter : public Writer {
+  struct Mapping {
+    void *data;
+    size_t size;
+  };
+
+  Mapping mapping_;
+
+  static Mapping map(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::ios_base::failure(
+          "Cannot open file", std::error_code(errno, std::generic_category()));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::ios_base::failure(
+          "Cannot stat file", std::error_code(error, std::generic_category()));
+    }
+    Mapping mapping{nullptr, static_cast<size_t>(info.st_size)};
+    if (mapping.size > 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      mapping.data = mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    int error = errno;
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+    if (mapping.data == MAP_FAILED) {
+      throw std::ios_base::failure(
+          "Cannot map file", std::error_code(error, std::generic_category()));
+    }
+    if (mapping.data != nullptr) {
+      madvise(mapping.data, mapping.size, MADV_SEQUENTIAL);
+    }
+    return mapping;
+  }
+
+  FileWriter(Mapping mapping, Encoding encoding)
+      : Writer(static_cast<const char *>(mapping.data), mapping.size,
+               encoding),
+        mapping_(mapping) {}
+
+public:
+  explicit FileWriter(const std::string &path,
+                      Encoding encoding = Encoding::text)
+      : FileWriter(map(path), encoding) {}
+
+  FileWriter(const FileWriter &) = delete;
+  FileWriter &operator=(const FileWriter &) = delete;
+
+  void close() override {
+    if (mapping_.data != nullptr) {
+      munmap(mapping_.data, mapping_.size);
+      mapping_.data = nullptr;
+    }
+    buffer = nullptr;
+    buffer_size_ = 0;
+    Writer::close();
+  }
+
+  ~FileWriter() { close(); }
+};
+
+// Bounded lock-free byte queue between exactly one producer thread and one
+// consumer thread. Each side owns one index and only reads the other's, so
+// neither needs a lock; a full queue makes the producer wait, which keeps
+// memory bounded however long the stream is.
+class RingBuffer {
+  std::vector<char> data_;
+  size_t mask_;
+  // Total bytes ever consumed and produced; the queue holds tail_ - head_.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) std::atomic<bool> closed_{false};
+
+  static void wait(unsigned &spins) {
+    if (++spins > 64) {
+      std::this_thread::yield();
+    }
+  }
+
+public:
+  // The capacity is rounded up to a power of two.
+  explicit RingBuffer(size_t capacity = 1 << 16) {
+    size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    data_.resize(size);
+    mask_ = size - 1;
+  }
+
+  size_t capacity() const { return data_.size(); }
+
+  // Producer side: copies as much of `data` as fits and returns how much.
+  size_t try_push(const char *data, size_t size) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    size = std::min(size, data_.size() - (tail - head));
+    size_t offset = tail & mask_;
+    size_t first = std::min(size, data_.size() - offset);
+    memcpy(data_.data() + offset, data, first);
+    memcpy(data_.data(), data + first, size - first);
+    tail_.store(tail + size, std::memory_order_release);
+    return size;
+  }
+
+  // Producer side: waits for room until all of `data` is queued.
+  void push(const char *data, size_t size) {
+    unsigned spins = 0;
+    while (size > 0) {
+      size_t pushed = try_push(data, size);
+      data += pushed;
+      size -= pushed;
+      if (pushed == 0) {
+        wait(spins);
+      }
+    }
+  }
+
+  // Producer side: no more data will follow.
+  void close() { closed_.store(true, std::memory_order_release); }
+
+  // Consumer side: moves up to `size` queued bytes into `data`.
+  size_t try_pop(char *data, size_t size) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size = std::min(size, tail - head);
+    size_t offset = head & mask_;
+    size_t first = std::min(size, data_.size() - offset);
+    memcpy(data, data_.data() + offset, first);
+    memcpy(data + first, data_.data(), size - first);
+    head_.store(head + size, std::memory_order_release);
+    return size;
+  }
+
+  // Consumer side: waits until some data arrives. Returns 0 only once the
+  // producer has closed the queue and everything has been consumed.
+  size_t pop(char *data, size_t size) {
+    unsigned spins = 0;
+    while (true) {
+      // Checked before popping so that data queued just before close()
+      // is never missed.
+      bool closed = closed_.load(std::memory_order_acquire);
+      size_t popped = try_pop(data, size);
+      if (popped > 0 || closed || size == 0) {
+        return popped;
+      }
+      wait(spins);
     }
-    if (caret_pos + 20 > buffer_size_) {
-      size_t delimiter_pos =
-          find_delimiter(buffer + caret_pos, buffer_size_ - caret_pos, ' ');
-      if (delimiter_pos == buffer_size_ - caret_pos) {
-        delimiter_pos =
-            find_delimiter(buffer + caret_pos, buffer_size_ - caret_pos, '\n');
-        if (delimiter_pos == buffer_size_ - caret_pos) {
-          set_eof(true);
-          char tmp[buffer_size_ - caret_pos + 1];
-          memcpy(tmp, buffer + caret_pos, buffer_size_ - caret_pos);
-          tmp[buffer_size_ - caret_pos] = '\0';
-          return std::stoll(tmp);
-        } else {
-          char tmp[delimiter_pos - caret_pos + 1];
-          memcpy(tmp, buffer + caret_pos, delimiter_pos - caret_pos);
-          tmp[delimiter_pos - caret_pos] = '\0';
-          caret_pos = delimiter_pos + 1;
-          return std::stoll(tmp);
+  }
+};
+
+// Reader that hands its output to a consumer thread through a RingBuffer.
+// Data is passed on whenever the local buffer fills up, on flush() and on
+// close(), which also ends the stream.
+class StreamReader : public Reader {
+  RingBuffer &ring_;
+
+protected:
+  void overflow(size_t size) override {
+    flush();
+    Reader::overflow(size);
+  }
+
+public:
+  StreamReader(RingBuffer &ring, size_t buffer_capacity = 1 << 12,
+               Encoding encoding = Encoding::text)
+      : Reader(buffer_capacity, encoding), ring_(ring) {}
+
+  void flush() {
+    ring_.push(buffer, buffer_size_);
+    buffer_size_ = 0;
+  }
+
+  void close() override {
+    if (!is_open_) {
+      return;
+    }
+    flush();
+    ring_.close();
+    Reader::close();
+  }
+
+  ~StreamReader() { close(); }
+};
+
+// Writer that parses what a StreamReader on another thread produces. Next
+// calls wait for data as needed; eof is reached once the producer has
+// closed the stream and every token has been read.
+class StreamWriter : public Writer {
+  RingBuffer &ring_;
+
+protected:
+  bool underflow() override {
+    // Keep the unfinished token, drop everything before it.
+    size_t left = buffer_size_ - caret_pos;
+    memmove(buffer, buffer + caret_pos, left);
+    caret_pos = 0;
+    buffer_size_ = left;
+    indexed_ = false;
+    if (buffer_size_ == buffer_capacity_) {
+      // A token longer than the whole buffer.
+      resize_buffer(buffer_capacity_ + 1);
+    }
+    size_t popped =
+        ring_.pop(buffer + buffer_size_, buffer_capacity_ - buffer_size_);
+    buffer_size_ += popped;
+    return popped > 0;
+  }
+
+  bool streaming() const override { return true; }
+
+public:
+  StreamWriter(RingBuffer &ring, size_t buffer_capacity = 1 << 12,
+               Encoding encoding = Encoding::text)
+      : Writer(buffer_capacity, nullptr, encoding), ring_(ring) {
+    set_eof(false);
+  }
+};
+
+// Writes one buffer at a time to a file in the background.
+class AsyncFlusher {
+public:
+  virtual ~AsyncFlusher() = default;
+
+  // Starts writing `size` bytes at `offset`. The previous write must have
+  // been waited for, and `data` must stay untouched until the next wait().
+  virtual void submit(const char *data, size_t size, off_t offset) = 0;
+
+  // Blocks until the submitted write is complete; throws if it failed.
+  virtual void wait() = 0;
+
+protected:
+  [[noreturn]] static void fail(int error) {
+    throw std::ios_base::failure(
+        "Cannot write file", std::error_code(error, std::generic_category()));
+  }
+};
+
+// Falls back to a helper thread doing plain pwrite calls.
+class ThreadFlusher : public AsyncFlusher {
+  int fd_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  off_t offset_ = 0;
+  bool busy_ = false, stopping_ = false;
+  int error_ = 0;
+  std::thread thread_;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      changed_.wait(lock, [&] { return busy_ || stopping_; });
+      if (!busy_) {
+        return;
+      }
+      lock.unlock();
+      int error = 0;
+      while (size_ > 0) {
+        ssize_t written = ::pwrite(fd_, data_, size_, offset_);
+        if (written < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          error = errno;
+          break;
         }
+        data_ += written;
+        size_ -= written;
+        offset_ += written;
+      }
+      lock.lock();
+      error_ = error;
+      busy_ = false;
+      changed_.notify_all();
+    }
+  }
+
+public:
+  explicit ThreadFlusher(int fd)
+      : fd_(fd), thread_(&ThreadFlusher::run, this) {}
+
+  ~ThreadFlusher() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [&] { return !busy_; });
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+  }
+
+  void submit(const char *data, size_t size, off_t offset) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    data_ = data;
+    size_ = size;
+    offset_ = offset;
+    busy_ = true;
+    changed_.notify_all();
+  }
+
+  void wait() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return !busy_; });
+    if (int error = std::exchange(error_, 0); error != 0) {
+      fail(error);
+    }
+  }
+};
+
+#if __has_include(<linux/io_uring.h>)
+// Submits writes through a small io_uring, talking to the kernel directly
+// so that no library is needed. At most one write is in flight.
+class UringFlusher : public AsyncFlusher {
+  int ring_fd_ = -1;
+  int fd_;
+  void *sq_ring_ = MAP_FAILED, *cq_ring_ = MAP_FAILED;
+  size_t sq_ring_size_ = 0, cq_ring_size_ = 0, sqes_size_ = 0;
+  io_uring_sqe *sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+  unsigned *sq_tail_, *sq_mask_, *sq_array_;
+  unsigned *cq_head_, *cq_tail_, *cq_mask_;
+  io_uring_cqe *cqes_;
+  iovec iov_{};
+  off_t offset_ = 0;
+  bool busy_ = false;
+
+  template <typename T> static T *at(void *ring, unsigned offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+  }
+
+  int enter(unsigned submit, unsigned wait) {
+    return syscall(__NR_io_uring_enter, ring_fd_, submit, wait,
+                   wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+  }
+
+  void push() {
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & *sq_mask_;
+    io_uring_sqe &sqe = sqes_[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = fd_;
+    sqe.addr = reinterpret_cast<uint64_t>(&iov_);
+    sqe.len = 1;
+    sqe.off = offset_;
+    sq_array_[index] = index;
+    // Without SQPOLL the kernel reads the tail only inside enter, and a
+    // failed enter consumes nothing.
+    std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1,
+                                               std::memory_order_release);
+    while (enter(1, 0) < 0) {
+      if (errno != EINTR && errno != EAGAIN) {
+        int error = errno;
+        // Take the entry back, or the next enter would submit a write of a
+        // buffer that has been handed back by then.
+        std::atomic_ref<unsigned>(*sq_tail_).store(tail,
+                                                   std::memory_order_release);
+        busy_ = false;
+        fail(error);
+      }
+    }
+  }
+
+  explicit UringFlusher(int fd) : fd_(fd) {}
+
+public:
+  // Null when the kernel does not offer io_uring.
+  static std::unique_ptr<UringFlusher> create(int fd) {
+    std::unique_ptr<UringFlusher> flusher(new UringFlusher(fd));
+    io_uring_params params{};
+    flusher->ring_fd_ = syscall(__NR_io_uring_setup, 2, &params);
+    if (flusher->ring_fd_ < 0) {
+      return nullptr;
+    }
+    UringFlusher &f = *flusher;
+    f.sq_ring_size_ =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    f.cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    f.sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    int prot = PROT_READ | PROT_WRITE, flags = MAP_SHARED | MAP_POPULATE;
+    f.sq_ring_ = mmap(nullptr, f.sq_ring_size_, prot, flags, f.ring_fd_,
+                      IORING_OFF_SQ_RING);
+    f.cq_ring_ = mmap(nullptr, f.cq_ring_size_, prot, flags, f.ring_fd_,
+                      IORING_OFF_CQ_RING);
+    f.sqes_ = static_cast<io_uring_sqe *>(mmap(
+        nullptr, f.sqes_size_, prot, flags, f.ring_fd_, IORING_OFF_SQES));
+    if (f.sq_ring_ == MAP_FAILED || f.cq_ring_ == MAP_FAILED ||
+        f.sqes_ == MAP_FAILED) {
+      return nullptr;
+    }
+    f.sq_tail_ = at<unsigned>(f.sq_ring_, params.sq_off.tail);
+    f.sq_mask_ = at<unsigned>(f.sq_ring_, params.sq_off.ring_mask);
+    f.sq_array_ = at<unsigned>(f.sq_ring_, params.sq_off.array);
+    f.cq_head_ = at<unsigned>(f.cq_ring_, params.cq_off.head);
+    f.cq_tail_ = at<unsigned>(f.cq_ring_, params.cq_off.tail);
+    f.cq_mask_ = at<unsigned>(f.cq_ring_, params.cq_off.ring_mask);
+    f.cqes_ = at<io_uring_cqe>(f.cq_ring_, params.cq_off.cqes);
+    return flusher;
+  }
+
+  ~UringFlusher() {
+    if (busy_) {
+      try {
+        wait();
+      } catch (const std::ios_base::failure &) {
+      }
+    }
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+      ::close(ring_fd_);
+    }
+  }
+
+  void submit(const char *data, size_t size, off_t offset) override {
+    iov_.iov_base = const_cast<char *>(data);
+    iov_.iov_len = size;
+    offset_ = offset;
+    busy_ = true;
+    push();
+  }
+
+  void wait() override {
+    while (busy_) {
+      unsigned head = *cq_head_;
+      if (head == std::atomic_ref<unsigned>(*cq_tail_).load(
+                      std::memory_order_acquire)) {
+        if (enter(0, 1) < 0 && errno != EINTR) {
+          busy_ = false;
+          fail(errno);
+        }
+        continue;
+      }
+      int result = cqes_[head & *cq_mask_].res;
+      std::atomic_ref<unsigned>(*cq_head_).store(head + 1,
+                                                 std::memory_order_release);
+      if (result == -EINTR || result == -EAGAIN) {
+        push();
+      } else if (result < 0) {
+        busy_ = false;
+        fail(-result);
+      } else if (static_cast<size_t>(result) < iov_.iov_len) {
+        // Short write: queue the rest.
+        iov_.iov_base = static_cast<char *>(iov_.iov_base) + result;
+        iov_.iov_len -= result;
+        offset_ += result;
+        push();
       } else {
-        char tmp[delimiter_pos - caret_pos + 1];
-        memcpy(tmp, buffer + caret_pos, delimiter_pos - caret_pos);
-        tmp[delimiter_pos - caret_pos] = '\0';
-        caret_pos = delimiter_pos + 1;
-        return std::stoll(tmp);
+        busy_ = false;
       }
-    } else {
-      char tmp[20];
-      memcpy(tmp, buffer + caret_pos, 10);
-      tmp[19] = '\0';
-      caret_pos += 20;
-      return std::stoll(tmp);
     }
-  };
+  }
+};
+#endif
+
+// FileReader variant that never waits for the disk while there is room:
+// it formats into one buffer while the other is being written out by
+// io_uring, or by a helper thread where io_uring is not available. Only
+// when both buffers are full does it wait. close() waits for everything.
+class AsyncFileReader : public Reader {
+  int fd_;
+  off_t offset_ = 0;
+  // The buffer being written while `buffer` is filled.
+  size_t spare_capacity_;
+  char *spare_;
+  bool pending_ = false;
+  bool uring_ = false;
+  std::unique_ptr<AsyncFlusher> flusher_;
 
-  size_t find_delimiter(const char *buffer, size_t buffer_size,
-                        char delimiter) {
-    for (size_t i = 0; i < buffer_size; ++i) {
-      if (buffer[i] == delimiter) {
-        return i;
+  void finish() {
+    if (pending_) {
+      pending_ = false;
+      flusher_->wait();
+    }
+  }
+
+protected:
+  void overflow(size_t size) override {
+    flush();
+    Reader::overflow(size);
+  }
+
+public:
+  explicit AsyncFileReader(const std::string &path,
+                           size_t buffer_capacity = 1 << 16,
+                           Encoding encoding = Encoding::text,
+                           bool use_io_uring = true)
+      : Reader(buffer_capacity, encoding), spare_capacity_(buffer_capacity),
+        spare_(allocate(spare_capacity_)) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      deallocate(spare_, spare_capacity_);
+      throw std::ios_base::failure(
+          "Cannot open file", std::error_code(errno, std::generic_category()));
+    }
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    // The destructor does not run if the constructor throws.
+    try {
+#if __has_include(<linux/io_uring.h>)
+      if (use_io_uring) {
+        flusher_ = UringFlusher::create(fd_);
+        uring_ = flusher_ != nullptr;
       }
+#endif
+      if (!flusher_) {
+        flusher_ = std::make_unique<ThreadFlusher>(fd_);
+      }
+    } catch (...) {
+      ::close(fd_);
+      deallocate(spare_, spare_capacity_);
+      throw;
     }
-    return buffer_size;
   }
-};
\ No newline at end of file
+
+  AsyncFileReader(const AsyncFileReader &) = delete;
+  AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+  bool uses_io_uring() const { return uring_; }
+
+  // Hands the buffered data to the backend and switches buffers.
+  void flush() {
+    if (buffer_size_ == 0) {
+      return;
+    }
+    finish();
+    flusher_->submit(buffer, buffer_size_, offset_);
+    pending_ = true;
+    offset_ += buffer_size_;
+    std::swap(buffer, spare_);
+    std::swap(buffer_capacity_, spare_capacity_);
+    buffer_size_ = 0;
+  }
+
+  void close() override {
+    if (!is_open_) {
+      return;
+    }
+    flush();
+    finish();
+    Reader::close();
+    if (::close(fd_) != 0) {
+      throw std::ios_base::failure(
+          "Cannot close file", std::error_code(errno, std::generic_category()));
+    }
+  }
+
+  // Closing here cannot report errors; call close() to see them.
+  ~AsyncFileReader() {
+    if (is_open_) {
+      try {
+        flush();
+        finish();
+      } catch (const std::ios_base::failure &) {
+      }
+      flusher_.reset();
+      ::close(fd_);
+    }
+    deallocate(spare_, spare_capacity_);
+  }
+};
@@ -1,5 +1,431 @@
 #include "../src/readerWriter.cpp"
 #include <gtest/gtest.h>
+#include <thread>
+
+TEST(ReaderTest, Numbers) {
+  Reader reader(4);
+  reader.read(-42);
+  reader.read(' ');
+  reader.read(9223372036854775807LL);
+  reader.read(' ');
+  reader.read(0.1f);
+  reader.read(' ');
+  reader.read(0.1);
+  reader.read(' ');
+  reader.read(true);
+  EXPECT_EQ(reader.data(),
+            "-42 9223372036854775807 0.1 0.10000000000000001 true");
+}
+
+TEST(ReaderTest, Strings) {
+  Reader reader(1);
+  std::string text = "abc";
+  reader.read(text);
+  reader.read(std::string_view("def"));
+  reader.read(std::span<const char>(text.data(), 2));
+  reader.read("!");
+  EXPECT_EQ(reader.data(), "abcdefab!");
+  EXPECT_EQ(reader.data().data()[reader.data().size()], '\0');
+}
+
+TEST(ReaderTest, Reserve) {
+  Reader reader(8);
+  reader.read("abc");
+  reader.reserve(4096);
+  EXPECT_EQ(reader.capacity(), 4096);
+  EXPECT_EQ(reader.data(), "abc");
+  reader.reserve(16);
+  EXPECT_EQ(reader.capacity(), 4096);
+  reader.close();
+  EXPECT_THROW(reader.read(1), std::ios_base::failure);
+}
+
+TEST(ReaderTest, Growth) {
+  Reader reader(0);
+  std::string big(5000, 'x');
+  reader.read(big);
+  EXPECT_GE(reader.capacity(), big.size() + 1);
+  EXPECT_EQ(reader.data(), big);
+  size_t capacity = reader.capacity();
+  reader.read('y');
+  EXPECT_GE(reader.capacity(), 2 * capacity);
+}
+
+TEST(ReaderTest, BufferPool) {
+  BufferPool &pool = BufferPool::local();
+  pool.set_limit(2);
+  const char *first;
+  {
+    Reader reader(100);
+    EXPECT_EQ(reader.capacity(), 128);
+    first = reader.data().data();
+  }
+  EXPECT_EQ(pool.size(), 1);
+  {
+    Reader reader(120);
+    EXPECT_EQ(reader.data().data(), first);
+    EXPECT_EQ(pool.size(), 0);
+    reader.read(std::string(300, 'x'));
+    Writer writer("1 2 3");
+    EXPECT_EQ(writer.write_int(), 1);
+  }
+  EXPECT_EQ(pool.size(), 3);
+  pool.set_limit(0);
+  EXPECT_EQ(pool.size(), 0);
+  EXPECT_EQ(Reader(100).capacity(), 100);
+}
+
+TEST(WriterTest, Numbers) {
+  Writer writer(" 12\t-7 3.5\n1e-3 abc 99999999999 \n");
+  EXPECT_EQ(writer.write_int(), 12);
+  EXPECT_EQ(writer.write_long(), -7);
+  Parsed<double> d = writer.next<double>();
+  ASSERT_TRUE(d);
+  EXPECT_EQ(d.value, 3.5);
+  float f;
+  EXPECT_EQ(writer.next(f), ParseResult::ok);
+  EXPECT_FLOAT_EQ(f, 1e-3f);
+  EXPECT_EQ(writer.next<int>().result, ParseResult::invalid);
+  std::string_view token;
+  EXPECT_EQ(writer.next(token), ParseResult::ok);
+  EXPECT_EQ(token, "abc");
+  EXPECT_EQ(writer.next<int>().result, ParseResult::out_of_range);
+  EXPECT_EQ(writer.write_long_long(), 99999999999LL);
+  EXPECT_TRUE(writer.get_eof());
+  EXPECT_EQ(writer.next<int>().result, ParseResult::end_of_input);
+  EXPECT_THROW(writer.write_int(), std::ios_base::failure);
+}
+
+TEST(WriterTest, RoundTrip) {
+  Reader reader;
+  reader.read(-3);
+  reader.read(' ');
+  reader.read(0.1);
+  reader.read('\n');
+  reader.read(123456789012LL);
+  char *owned = new char[reader.data().size()];
+  memcpy(owned, reader.data().data(), reader.data().size());
+  Writer writer(reader.data().size(), owned);
+  EXPECT_EQ(writer.write_int(), -3);
+  EXPECT_EQ(writer.next<double>().value, 0.1);
+  EXPECT_EQ(writer.write_long_long(), 123456789012LL);
+  writer.close();
+  EXPECT_EQ(writer.next<int>().result, ParseResult::closed);
+}
+
+TEST(WriterTest, TokenIndex) {
+  std::string text;
+  std::vector<long long> expected;
+  for (int i = 0; i < 1000; ++i) {
+    expected.push_back((i * 7919LL) % 100003 - 50000);
+    text += std::to_string(expected.back());
+    text += i % 13 == 0 ? "\r\n" : i % 5 == 0 ? "\t  " : " ";
+  }
+  Writer scanned(text), indexed(text);
+  EXPECT_EQ(indexed.index_tokens(), expected.size());
+  EXPECT_EQ(scanned.find_delimiter(), text.find_first_of(" \t\r\n"));
+  for (long long value : expected) {
+    ASSERT_EQ(scanned.write_long_long(), value);
+    ASSERT_EQ(indexed.write_long_long(), value);
+  }
+  EXPECT_TRUE(scanned.get_eof());
+  EXPECT_TRUE(indexed.get_eof());
+}
+
+TEST(WriterTest, Bulk) {
+  std::vector<long long> longs;
+  std::vector<double> doubles;
+  for (int i = 0; i < 5000; ++i) {
+    longs.push_back((i - 2500) * 1234567891LL);
+    doubles.push_back(i / 7.0 - 300);
+  }
+  for (Encoding encoding : {Encoding::text, Encoding::binary}) {
+    Reader reader(16, encoding);
+    reader.read(std::span<const long long>(longs));
+    reader.read(std::span<const double>(doubles), '\n');
+
+    Writer writer(reader.data(), encoding);
+    std::vector<long long> parsedLongs(longs.size());
+    EXPECT_EQ(writer.next_n(std::span<long long>(parsedLongs)), longs.size());
+    EXPECT_EQ(parsedLongs, longs);
+    std::vector<double> parsedDoubles(doubles.size() + 1);
+    EXPECT_EQ(writer.next_n(std::span<double>(parsedDoubles)),
+              doubles.size());
+    parsedDoubles.pop_back();
+    EXPECT_EQ(parsedDoubles, doubles);
+    EXPECT_TRUE(writer.get_eof());
+  }
+
+  Writer partial("1 2 x 4");
+  std::vector<int> ints(4);
+  EXPECT_EQ(partial.next_n(std::span<int>(ints)), 2);
+  EXPECT_EQ(partial.next<std::string_view>().value, "x");
+}
+
+TEST(FileTest, RoundTrip) {
+  std::string path = testing::TempDir() + "readerWriter_numbers.txt";
+  {
+    FileReader out(path, 64);
+    for (int i = 0; i < 1000; ++i) {
+      out.read(i * 3 - 500);
+      out.read('\n');
+    }
+    out.read(std::string(200, 'x'));
+    out.close();
+    EXPECT_THROW(out.read(1), std::ios_base::failure);
+  }
+  FileWriter in(path);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(in.write_int(), i * 3 - 500);
+  }
+  std::string_view tail;
+  EXPECT_EQ(in.next(tail), ParseResult::ok);
+  EXPECT_EQ(tail, std::string(200, 'x'));
+  EXPECT_TRUE(in.get_eof());
+  in.close();
+  EXPECT_EQ(in.next<int>().result, ParseResult::closed);
+  unlink(path.c_str());
+  EXPECT_THROW(FileWriter missing(path), std::ios_base::failure);
+}
+
+TEST(FileTest, BoundedBuffer) {
+  std::string path = testing::TempDir() + "readerWriter_bounded.txt";
+  {
+    FileReader out(path, 4096);
+    for (int i = 0; i < 200000; ++i) {
+      out.read(i);
+      out.read(' ');
+    }
+    // Flushing makes room, so the buffer never has to grow.
+    EXPECT_EQ(out.capacity(), 4096);
+    out.read(std::string(5000, 'x'));
+    EXPECT_GE(out.capacity(), 5001);
+  }
+  unlink(path.c_str());
+}
+
+TEST(FileTest, BoundedBulk) {
+  std::string path = testing::TempDir() + "readerWriter_bulk.bin";
+  std::vector<int> ints(1000000);
+  std::vector<double> doubles(100000);
+  for (size_t i = 0; i < ints.size(); ++i) {
+    ints[i] = static_cast<int>(i * 7919 % 6000000) - 3000000;
+  }
+  for (size_t i = 0; i < doubles.size(); ++i) {
+    doubles[i] = i * 0.25;
+  }
+  {
+    FileReader out(path, 4096, Encoding::binary);
+    out.read(std::span<const int>(ints));
+    out.read(std::span<const double>(doubles));
+    EXPECT_EQ(out.capacity(), 4096);
+  }
+  FileWriter in(path, Encoding::binary);
+  std::vector<int> decoded(ints.size());
+  EXPECT_EQ(in.next_n(std::span<int>(decoded)), ints.size());
+  EXPECT_EQ(decoded, ints);
+  std::vector<double> decodedDoubles(doubles.size());
+  EXPECT_EQ(in.next_n(std::span<double>(decodedDoubles)), doubles.size());
+  EXPECT_EQ(decodedDoubles, doubles);
+  unlink(path.c_str());
+
+  // In text a batch is sized to the buffer as well.
+  {
+    FileReader out(path, 1024);
+    out.read(std::span<const double>(doubles));
+    EXPECT_EQ(out.capacity(), 1024);
+  }
+  FileWriter text(path);
+  std::vector<double> parsed(doubles.size());
+  EXPECT_EQ(text.next_n(std::span<double>(parsed)), doubles.size());
+  EXPECT_EQ(parsed, doubles);
+  unlink(path.c_str());
+}
+
+TEST(StreamTest, ProducerConsumer) {
+  RingBuffer ring(256);
+  constexpr int count = 100000;
+  std::thread producer([&] {
+    StreamReader out(ring, 100);
+    for (int i = 0; i < count; ++i) {
+      out.read(i * 37 - 1000000);
+      out.read(i % 10 == 0 ? '\n' : ' ');
+    }
+    out.read(std::string(1000, 'y'));
+  });
+  StreamWriter in(ring, 16);
+  // No ASSERT while the producer runs: returning early would leave it
+  // joinable, and it could block forever on the full ring.
+  for (int i = 0; i < count && !HasFailure(); ++i) {
+    EXPECT_EQ(in.next<int>().value, i * 37 - 1000000);
+  }
+  std::string_view tail;
+  EXPECT_EQ(in.next(tail), ParseResult::ok);
+  EXPECT_EQ(tail.size(), 1000);
+  EXPECT_EQ(in.next<int>().result, ParseResult::end_of_input);
+  EXPECT_TRUE(in.get_eof());
+  // Drain whatever is left after a failure so that the producer finishes.
+  while (in.next<std::string_view>()) {
+  }
+  producer.join();
+  EXPECT_LE(ring.capacity(), 256);
+}
+
+TEST(StreamTest, TokenIndex) {
+  RingBuffer ring(64);
+  constexpr int count = 20000;
+  std::thread producer([&] {
+    StreamReader out(ring, 32);
+    for (int i = 0; i < count; ++i) {
+      out.read(i * 7919 - 1000000);
+      out.read(' ');
+    }
+  });
+  // Refills of at most 16 bytes split most numbers. The index stops before
+  // a token that is still arriving, which is read once it is complete.
+  StreamWriter in(ring, 16);
+  int i = 0;
+  while (i < count && !HasFailure()) {
+    size_t tokens = std::max<size_t>(in.index_tokens(), 1);
+    for (size_t k = 0; k < tokens && i < count && !HasFailure(); ++k, ++i) {
+      EXPECT_EQ(in.next<int>().value, i * 7919 - 1000000) << i;
+    }
+  }
+  EXPECT_EQ(in.next<int>().result, ParseResult::end_of_input);
+  while (in.next<std::string_view>()) {
+  }
+  producer.join();
+}
+
+TEST(BinaryTest, Values) {
+  Reader reader(4, Encoding::binary);
+  reader.read(0);
+  reader.read(-1);
+  reader.read(300);
+  reader.read(-9223372036854775807LL - 1);
+  reader.read(0.1);
+  reader.read(2.5f);
+  reader.read(std::string_view("hello world"));
+  reader.read('x');
+  reader.read(true);
+  // 1 + 1 + 2 + 10 varint bytes, 8 + 4 float bytes, 1 + 11, 1, 1.
+  EXPECT_EQ(reader.data().size(), 40);
+
+  Writer writer(reader.data(), Encoding::binary);
+  EXPECT_EQ(writer.write_int(), 0);
+  EXPECT_EQ(writer.write_int(), -1);
+  EXPECT_EQ(writer.next<char>().result, ParseResult::ok);
+  Writer again(reader.data(), Encoding::binary);
+  again.write_int();
+  again.write_int();
+  EXPECT_EQ(again.write_long(), 300);
+  EXPECT_EQ(again.next<int>().result, ParseResult::out_of_range);
+  EXPECT_EQ(again.write_long_long(), -9223372036854775807LL - 1);
+  EXPECT_EQ(again.next<double>().value, 0.1);
+  EXPECT_EQ(again.next<float>().value, 2.5f);
+  EXPECT_EQ(again.next<std::string_view>().value, "hello world");
+  EXPECT_EQ(again.next<char>().value, 'x');
+  EXPECT_TRUE(again.next<bool>().value);
+  EXPECT_TRUE(again.get_eof());
+
+  Writer truncated(reader.data().substr(0, 5), Encoding::binary);
+  // The 0 also reads as an empty string.
+  EXPECT_EQ(truncated.next<std::string_view>().value, "");
+  EXPECT_EQ(truncated.next<long long>().value, -1);
+  EXPECT_EQ(truncated.next<long long>().value, 300);
+  EXPECT_EQ(truncated.next<long long>().result, ParseResult::end_of_input);
+  EXPECT_FALSE(truncated.get_eof());
+}
+
+TEST(BinaryTest, StringLengths) {
+  Reader reader(4, Encoding::binary);
+  // 100 needs one unsigned varint byte but two after zigzag.
+  reader.read(std::string(100, 'a'));
+  EXPECT_EQ(reader.data().size(), 101);
+  Writer writer(reader.data(), Encoding::binary);
+  EXPECT_EQ(writer.next<std::string_view>().value, std::string(100, 'a'));
+
+  // Lengths past the end of the input are rejected, not waited for.
+  Writer shorter(std::string_view("\x05" "ab"), Encoding::binary);
+  EXPECT_EQ(shorter.next<std::string_view>().result, ParseResult::invalid);
+  EXPECT_EQ(shorter.next<char>().value, 5);
+  std::string huge(9, '\xff');
+  huge += '\x01';
+  Writer overflowing(huge, Encoding::binary);
+  EXPECT_EQ(overflowing.next<std::string_view>().result,
+            ParseResult::invalid);
+}
+
+TEST(BinaryTest, Arrays) {
+  std::vector<int> ints;
+  for (int i = 0; i < 1000; ++i) {
+    ints.push_back(i % 7 == 0 ? i * 100000 : i % 64 - 32);
+  }
+  std::vector<double> doubles{0.5, -1e300, 3};
+  Reader reader(16, Encoding::binary);
+  reader.read(std::span<const int>(ints));
+  reader.read(std::span<const double>(doubles));
+
+  Writer writer(reader.data(), Encoding::binary);
+  std::vector<int> decoded(ints.size());
+  EXPECT_EQ(writer.next_n(std::span<int>(decoded)), ints.size());
+  EXPECT_EQ(decoded, ints);
+  std::vector<double> decodedDoubles(4);
+  EXPECT_EQ(writer.next_n(std::span<double>(decodedDoubles)), 3);
+  decodedDoubles.pop_back();
+  EXPECT_EQ(decodedDoubles, doubles);
+  EXPECT_TRUE(writer.get_eof());
+
+  Reader text;
+  text.read(std::span<const int>(ints.data(), 3), '\n');
+  EXPECT_EQ(text.data(), "0\n-31\n-30\n");
+}
+
+TEST(BinaryTest, Stream) {
+  RingBuffer ring(64);
+  std::thread producer([&] {
+    StreamReader out(ring, 32, Encoding::binary);
+    for (int i = 0; i < 10000; ++i) {
+      out.read(i * 1001);
+      out.read(std::string_view("abcdefghijklmnopqrstuvwxyz", i % 27));
+    }
+  });
+  StreamWriter in(ring, 8, Encoding::binary);
+  for (int i = 0; i < 10000 && !HasFailure(); ++i) {
+    EXPECT_EQ(in.next<int>().value, i * 1001);
+    EXPECT_EQ(in.next<std::string_view>().value.size(), i % 27);
+  }
+  EXPECT_EQ(in.next<int>().result, ParseResult::end_of_input);
+  // Drain whatever is left after a failure so that the producer finishes.
+  while (in.next<char>()) {
+  }
+  producer.join();
+}
+
+TEST(FileTest, AsyncFlush) {
+  for (bool uring : {true, false}) {
+    std::string path = testing::TempDir() + "readerWriter_async.txt";
+    {
+      AsyncFileReader out(path, 128, Encoding::text, uring);
+      if (!uring) {
+        EXPECT_FALSE(out.uses_io_uring());
+      }
+      for (int i = 0; i < 20000; ++i) {
+        out.read(i);
+        out.read(' ');
+      }
+      out.read(std::string(500, 'z'));
+      out.close();
+    }
+    FileWriter in(path);
+    for (int i = 0; i < 20000; ++i) {
+      ASSERT_EQ(in.write_int(), i);
+    }
+    EXPECT_EQ(in.next<std::string_view>().value, std::string(500, 'z'));
+    EXPECT_TRUE(in.get_eof());
+    unlink(path.c_str());
+  }
+}
 
 int main(int argc, char **argv)
 {